@@ -1,22 +1,108 @@
 #include "CarCollection.h"
 
+//  Money реализация 
+Money Money::fromDouble(double rubles) {
+    const double kopecks = std::round(rubles * 100.0);
+    if (!std::isfinite(kopecks) || std::fabs(kopecks) >= 9.2e18) {
+        throw std::invalid_argument("Price out of range");
+    }
+    return Money(static_cast<int64_t>(kopecks));
+}
+
+std::optional<Money> Money::parse(std::string_view text) {
+    bool negative = false;
+    if (!text.empty() && (text.front() == '-' || text.front() == '+')) {
+        negative = text.front() == '-';
+        text.remove_prefix(1);
+    }
+    if (text.empty()) {
+        return std::nullopt;
+    }
+
+    const int64_t limit = std::numeric_limits<int64_t>::max() / 100;
+    int64_t rubles = 0;
+    size_t pos = 0;
+    for (; pos < text.size() && text[pos] != '.'; ++pos) {
+        if (text[pos] < '0' || text[pos] > '9' || rubles > (limit - 9) / 10) {
+            return std::nullopt;
+        }
+        rubles = rubles * 10 + (text[pos] - '0');
+    }
+
+    int64_t fraction = 0;
+    if (pos < text.size()) {
+        const std::string_view digits = text.substr(pos + 1);
+        if (digits.empty() && pos == 0) {
+            return std::nullopt;
+        }
+        if (digits.size() > 2) {
+            return std::nullopt;
+        }
+        for (char c : digits) {
+            if (c < '0' || c > '9') {
+                return std::nullopt;
+            }
+            fraction = fraction * 10 + (c - '0');
+        }
+        if (digits.size() == 1) {
+            fraction *= 10;
+        }
+    }
+
+    const int64_t kopecks = rubles * 100 + fraction;
+    return Money(negative ? -kopecks : kopecks);
+}
+
+std::string Money::toString() const {
+    // Модуль в беззнаковом типе: -INT64_MIN не представим в int64_t
+    const uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    const unsigned cents = static_cast<unsigned>(magnitude % 100);
+    std::string text = value < 0 ? "-" : "";
+    text += std::to_string(magnitude / 100);
+    text += '.';
+    text += static_cast<char>('0' + cents / 10);
+    text += static_cast<char>('0' + cents % 10);
+    return text;
+}
+
+Money Money::scaled(int64_t numerator, int64_t denominator) const {
+    if (denominator <= 0) {
+        throw std::invalid_argument("Denominator must be positive");
+    }
+    // Деление с остатком до умножения, чтобы промежуточное значение не переполнилось
+    const int64_t whole = value / denominator;
+    const int64_t rest = value % denominator;
+    const int64_t product = rest * numerator;
+    int64_t rounded = product / denominator;
+    const int64_t remainder = product % denominator;
+    if (2 * (remainder < 0 ? -remainder : remainder) >= denominator) {
+        rounded += product < 0 ? -1 : 1;
+    }
+    return Money(whole * numerator + rounded);
+}
+
 //  Vehicle реализация 
-int Vehicle::vehicleCount = 0;
+std::atomic<int> Vehicle::vehicleCount{ 0 };
 
-Vehicle::Vehicle() : manufacturer(""), model(""), year(0), price(0.0) {
-    vehicleCount++;
+Vehicle::Vehicle() : manufacturer(""), model(""), year(0), price() {
+    vehicleCount.fetch_add(1, std::memory_order_relaxed);
 }
 
-Vehicle::Vehicle(const std::string& manufacturer, const std::string& model,
+Vehicle::Vehicle(std::string manufacturer, std::string model,
+    int year, Money price)
+    : manufacturer(std::move(manufacturer)), model(std::move(model)), year(year), price(price) {
+    vehicleCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+Vehicle::Vehicle(std::string manufacturer, std::string model,
     int year, double price)
-    : manufacturer(manufacturer), model(model), year(year), price(price) {
-    vehicleCount++;
+    : Vehicle(std::move(manufacturer), std::move(model), year, Money::fromDouble(price)) {
 }
 
 Vehicle::Vehicle(const Vehicle& other)
     : manufacturer(other.manufacturer), model(other.model),
     year(other.year), price(other.price) {
-    vehicleCount++;
+    vehicleCount.fetch_add(1, std::memory_order_relaxed);
 }
 
 Vehicle::Vehicle(Vehicle&& other) noexcept
@@ -25,8 +111,9 @@ Vehicle::Vehicle(Vehicle&& other) noexcept
     year(other.year),
     price(other.price) {
     other.year = 0;
-    other.price = 0.0;
-    vehicleCount++;
+    other.price = Money();
+    other.invalidateRender();
+    vehicleCount.fetch_add(1, std::memory_order_relaxed);
 }
 
 Vehicle& Vehicle::operator=(const Vehicle& other) {
@@ -35,6 +122,7 @@ Vehicle& Vehicle::operator=(const Vehicle& other) {
         model = other.model;
         year = other.year;
         price = other.price;
+        invalidateRender();
     }
     return *this;
 }
@@ -47,7 +135,9 @@ Vehicle& Vehicle::operator=(Vehicle&& other) noexcept {
         price = other.price;
 
         other.year = 0;
-        other.price = 0.0;
+        other.price = Money();
+        invalidateRender();
+        other.invalidateRender();
     }
     return *this;
 }
@@ -78,21 +168,30 @@ void Vehicle::updateInfo(const std::string& manufacturer, const std::string& mod
     this->manufacturer = manufacturer;
     this->model = model;
     this->year = year;
-    this->price = price;
+    this->price = Money::fromDouble(price);
+    invalidateRender();
 }
 
 void Vehicle::updateInfo(const std::string& manufacturer, const std::string& model) {
     this->manufacturer = manufacturer;
     this->model = model;
+    invalidateRender();
+}
+
+const std::string& Vehicle::renderedString() const {
+    if (renderCache.empty()) {
+        renderCache = toString();
+    }
+    return renderCache;
 }
 
 int Vehicle::getVehicleCount() {
-    return vehicleCount;
+    return vehicleCount.load(std::memory_order_relaxed);
 }
 
 void Vehicle::print(std::ostream& os) const {
     os << manufacturer << " " << model << " (" << year << ") - "
-        << std::fixed << std::setprecision(2) << price << " руб.";
+        << price << " руб.";
 }
 
 inline std::ostream& operator<<(std::ostream& os, const Vehicle& vehicle) {
@@ -106,14 +205,21 @@ condition(Condition::GOOD), scale("1:64"),
 color("Красный"), limitedEdition(false) {
 }
 
-Car::Car(const std::string& manufacturer, const std::string& model,
-    int year, double price, CarType type, Condition condition,
-    const std::string& scale, const std::string& color, bool limitedEdition)
-    : Vehicle(manufacturer, model, year, price), type(type),
-    condition(condition), scale(scale), color(color),
+Car::Car(std::string manufacturer, std::string model,
+    int year, Money price, CarType type, Condition condition,
+    std::string scale, std::string color, bool limitedEdition)
+    : Vehicle(std::move(manufacturer), std::move(model), year, price), type(type),
+    condition(condition), scale(std::move(scale)), color(std::move(color)),
     limitedEdition(limitedEdition) {
 }
 
+Car::Car(std::string manufacturer, std::string model,
+    int year, double price, CarType type, Condition condition,
+    std::string scale, std::string color, bool limitedEdition)
+    : Car(std::move(manufacturer), std::move(model), year, Money::fromDouble(price),
+        type, condition, std::move(scale), std::move(color), limitedEdition) {
+}
+
 Car::Car(const Car& other)
     : Vehicle(other), type(other.type), condition(other.condition),
     scale(other.scale), color(other.color),
@@ -134,6 +240,7 @@ Car& Car::operator=(const Car& other) {
         scale = other.scale;
         color = other.color;
         limitedEdition = other.limitedEdition;
+        invalidateRender();
     }
     return *this;
 }
@@ -146,24 +253,45 @@ Car& Car::operator=(Car&& other) noexcept {
         scale = std::move(other.scale);
         color = std::move(other.color);
         limitedEdition = other.limitedEdition;
+        invalidateRender();
     }
     return *this;
 }
 
+bool Car::operator==(const Car& other) const {
+    return Vehicle::operator==(other) &&
+        type == other.type &&
+        condition == other.condition &&
+        scale == other.scale &&
+        color == other.color &&
+        limitedEdition == other.limitedEdition;
+}
+
+bool Car::operator!=(const Car& other) const {
+    return !(*this == other);
+}
+
 void Car::displayInfo() const {
-    std::cout << toString() << std::endl;
+    // Без std::endl: сброс буфера на каждой машинке делает вывод списков медленным
+    std::cout << renderedString() << '\n';
 }
 
 std::string Car::toString() const {
-    std::ostringstream oss;
-    oss << manufacturer << " " << model << " (" << year << ")\n"
-        << "Тип: " << EnumUtils::carTypeToStr(type) << "\n"
-        << "Состояние: " << EnumUtils::conditionToStr(condition) << "\n"
-        << "Масштаб: " << scale << "\n"
-        << "Цвет: " << color << "\n"
-        << "Лимитированная серия: " << (limitedEdition ? "Да" : "Нет") << "\n"
-        << "Цена: " << std::fixed << std::setprecision(2) << price << " руб.";
-    return oss.str();
+    const std::string priceText = price.toString();
+    const std::string_view typeName = EnumUtils::carTypeToStr(type);
+    const std::string_view conditionName = EnumUtils::conditionToStr(condition);
+
+    std::string text;
+    text.reserve(256 + manufacturer.size() + model.size() + scale.size() + color.size());
+    text.append(manufacturer).append(" ").append(model)
+        .append(" (").append(std::to_string(year)).append(")\n")
+        .append("Тип: ").append(typeName.data(), typeName.size()).append("\n")
+        .append("Состояние: ").append(conditionName.data(), conditionName.size()).append("\n")
+        .append("Масштаб: ").append(scale).append("\n")
+        .append("Цвет: ").append(color).append("\n")
+        .append("Лимитированная серия: ").append(limitedEdition ? "Да" : "Нет").append("\n")
+        .append("Цена: ").append(priceText).append(" руб.");
+    return text;
 }
 
 std::unique_ptr<Vehicle> Car::clone() const {
@@ -179,37 +307,45 @@ void Car::updateInfo(const std::string& manufacturer, const std::string& model,
     this->scale = scale;
     this->color = color;
     this->limitedEdition = limitedEdition;
+    invalidateRender();
 }
 
-double Car::calculateValue() const {
-    double value = price;
+Money Car::calculateValue() const {
+    int64_t percent = 100;
 
     switch (condition) {
     case Condition::MINT:
-        value *= MINT_CONDITION_BONUS;
+        percent = MINT_CONDITION_BONUS_PERCENT;
         break;
     case Condition::EXCELLENT:
-        value *= 1.1;
+        percent = 110;
         break;
     case Condition::GOOD:
         break;
     case Condition::FAIR:
-        value *= 0.8;
+        percent = 80;
         break;
     case Condition::POOR:
-        value *= 0.5;
+        percent = 50;
         break;
     }
 
+    // Множители перемножаются как целые проценты, округление - одно на результат
+    int64_t denominator = 100;
     if (limitedEdition) {
-        value *= RARE_MULTIPLIER;
+        percent *= RARE_MULTIPLIER_PERCENT;
+        denominator *= 100;
     }
 
-    return value;
+    return price.scaled(percent, denominator);
 }
 
 bool Car::isValuable() const {
-    return calculateValue() > 10000.0;
+    return calculateValue() > Money::fromKopecks(1000000);
+}
+
+uint64_t Car::identityHash() const {
+    return HashUtils::hashIdentity(manufacturer, model, year, scale, color);
 }
 
 void Car::print(std::ostream& os) const {
@@ -223,194 +359,2007 @@ inline std::ostream& operator<<(std::ostream& os, const Car& car) {
     return os;
 }
 
-//  FileHandler реализация 
-bool FileHandler::exportToCSV(const Collection<Car>& collection, const std::string& filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
-        return false;
+//  Trace реализация 
+namespace Trace {
+    Tracer& Tracer::instance() {
+        static Tracer tracer;
+        return tracer;
     }
 
-    // Заголовок CSV на английском
-    file << "Manufacturer;Model;Year;Price;Type;Condition;Scale;Color;LimitedEdition\n";
+    Tracer::Tracer() : origin(std::chrono::steady_clock::now()) {}
 
-    // Данные на английском
-    for (const auto& carPtr : collection) {
-        const Car* car = dynamic_cast<Car*>(carPtr.get());
-        if (car) {
-            file << car->getManufacturer() << ";"
-                << car->getModel() << ";"
-                << car->getYear() << ";"
-                << std::fixed << std::setprecision(2) << car->getPrice() << ";"
-                << EnumUtils::carTypeToStrEN(car->getType()) << ";"
-                << EnumUtils::conditionToStrEN(car->getCondition()) << ";"
-                << car->getScale() << ";"
-                << car->getColor() << ";"
-                << (car->isLimitedEdition() ? "Yes" : "No") << "\n";
-        }
+    double Tracer::nowUs() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
     }
 
-    file.close();
-    return file.good();
-}
+    uint32_t Tracer::threadIndex() {
+        auto inserted = threads.emplace(std::this_thread::get_id(), static_cast<uint32_t>(threads.size()));
+        return inserted.first->second;
+    }
 
-bool FileHandler::importFromCSV(Collection<Car>& collection, const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
-        return false;
+    void Tracer::addEvent(const char* name, double startUs, double durationUs) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(Event{ name, 'X', startUs, durationUs, 0, threadIndex() });
+        Stat& stat = stats[name];
+        stat.calls++;
+        stat.totalUs += durationUs;
+        stat.maxUs = std::max(stat.maxUs, durationUs);
     }
 
-    std::string line;
-    // Пропускаем заголовок
-    if (!std::getline(file, line)) {
-        std::cerr << "Файл пуст или не содержит заголовка\n";
-        return false;
+    void Tracer::addCounter(const char* name, int64_t value) {
+        const double ts = nowUs();
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(Event{ name, 'C', ts, 0.0, value, threadIndex() });
     }
 
-    int lineNum = 1;
-    while (std::getline(file, line)) {
-        lineNum++;
-        std::stringstream ss(line);
-        std::string token;
-        std::vector<std::string> tokens;
+    void Tracer::addSummary(const char* name, uint64_t calls, double totalUs, double maxUs) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stat& stat = stats[name];
+        stat.calls += calls;
+        stat.totalUs += totalUs;
+        stat.maxUs = std::max(stat.maxUs, maxUs);
+    }
 
-        while (std::getline(ss, token, ';')) {
-            tokens.push_back(token);
+    bool Tracer::writeChromeTrace(const std::string& filename) const {
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "Ошибка открытия файла: " << filename << std::endl;
+            return false;
         }
 
-        if (tokens.size() == 9) {
-            try {
-                auto car = std::make_shared<Car>(
-                    tokens[0], // manufacturer
-                    tokens[1], // model
-                    std::stoi(tokens[2]), // year
-                    std::stod(tokens[3]), // price
-                    EnumUtils::stringToCarType(tokens[4]), // type
-                    EnumUtils::stringToCondition(tokens[5]), // condition
-                    tokens[6], // scale
-                    tokens[7], // color
-                    tokens[8] == "Yes" || tokens[8] == "1" // limitedEdition
-                );
-                collection.addItem(car);
+        std::lock_guard<std::mutex> lock(mutex);
+        file << "{\"traceEvents\":[\n" << std::fixed << std::setprecision(3);
+        for (size_t i = 0; i < events.size(); ++i) {
+            const Event& e = events[i];
+            file << "{\"name\":\"" << e.name << "\",\"ph\":\"" << e.phase
+                << "\",\"ts\":" << e.ts << ",\"pid\":1,\"tid\":" << e.tid;
+            if (e.phase == 'X') {
+                file << ",\"dur\":" << e.dur;
             }
-            catch (const std::exception& e) {
-                std::cerr << "Ошибка парсинга строки " << lineNum << ": " << line
-                    << " - " << e.what() << std::endl;
-                continue;
+            else {
+                file << ",\"args\":{\"value\":" << e.value << "}";
             }
+            file << "}" << (i + 1 < events.size() ? ",\n" : "\n");
         }
-        else {
-            std::cerr << "Неверное количество полей в строке " << lineNum
-                << ": " << tokens.size() << " вместо 9\n";
+        file << "],\"displayTimeUnit\":\"ms\"}\n";
+        return file.good();
+    }
+
+    void Tracer::printSummary(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        // setw считает байты, а не символы UTF-8, поэтому заголовок выровнен вручную
+        out << "Участок" << std::string(29, ' ')
+            << "   Вызовов" << "     Всего, мс" << "   Средн., мкс" << "    Макс., мкс" << "\n";
+        for (const auto& entry : stats) {
+            const Stat& stat = entry.second;
+            out << std::left << std::setw(36) << entry.first << std::right
+                << std::setw(10) << stat.calls
+                << std::setw(14) << std::fixed << std::setprecision(3) << stat.totalUs / 1000.0
+                << std::setw(14) << std::setprecision(2) << stat.totalUs / static_cast<double>(stat.calls)
+                << std::setw(14) << stat.maxUs << "\n";
         }
     }
 
-    file.close();
-    return true;
+    bool Tracer::empty() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return events.empty() && stats.empty();
+    }
+
+    void Tracer::reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.clear();
+        stats.clear();
+        origin = std::chrono::steady_clock::now();
+    }
 }
 
-bool FileHandler::saveToBinary(const Collection<Car>& collection, const std::string& filename) {
-    std::ofstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
-        return false;
+//  AllocProfile реализация 
+namespace {
+    // Нулевая инициализация atomic выполняется статически - до первого operator new
+    std::atomic<uint64_t> totalAllocations(0);
+    std::atomic<uint64_t> totalBytes(0);
+
+    std::mutex& allocRegistryMutex() {
+        static std::mutex mutex;
+        return mutex;
     }
 
-    size_t size = collection.size();
-    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    std::map<std::string, AllocProfile::Stat>& allocRegistry() {
+        static std::map<std::string, AllocProfile::Stat> registry;
+        return registry;
+    }
+}
 
-    for (const auto& carPtr : collection) {
-        const Car* car = dynamic_cast<Car*>(carPtr.get());
-        if (car) {
-            std::string manufacturer = car->getManufacturer();
-            std::string model = car->getModel();
-            int year = car->getYear();
-            double price = car->getPrice();
-            CarType type = car->getType();
-            Condition condition = car->getCondition();
-            std::string scale = car->getScale();
-            std::string color = car->getColor();
-            bool limitedEdition = car->isLimitedEdition();
+#ifdef CARS_ALLOC_TRACKING
+// GCC 11+ не видит, что free парный к замененному operator new, и предупреждает
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    totalBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
 
-            size_t manufSize = manufacturer.size();
-            file.write(reinterpret_cast<const char*>(&manufSize), sizeof(manufSize));
-            file.write(manufacturer.c_str(), manufSize);
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
 
-            size_t modelSize = model.size();
-            file.write(reinterpret_cast<const char*>(&modelSize), sizeof(modelSize));
-            file.write(model.c_str(), modelSize);
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
 
-            file.write(reinterpret_cast<const char*>(&year), sizeof(year));
-            file.write(reinterpret_cast<const char*>(&price), sizeof(price));
-            file.write(reinterpret_cast<const char*>(&type), sizeof(type));
-            file.write(reinterpret_cast<const char*>(&condition), sizeof(condition));
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
 
-            size_t scaleSize = scale.size();
-            file.write(reinterpret_cast<const char*>(&scaleSize), sizeof(scaleSize));
-            file.write(scale.c_str(), scaleSize);
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
 
-            size_t colorSize = color.size();
-            file.write(reinterpret_cast<const char*>(&colorSize), sizeof(colorSize));
-            file.write(color.c_str(), colorSize);
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
 
-            file.write(reinterpret_cast<const char*>(&limitedEdition), sizeof(limitedEdition));
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+namespace AllocProfile {
+    uint64_t allocationCount() {
+        return totalAllocations.load(std::memory_order_relaxed);
+    }
+
+    uint64_t allocatedBytes() {
+        return totalBytes.load(std::memory_order_relaxed);
+    }
+
+    Scope::~Scope() {
+        const uint64_t allocations = allocationCount() - startCount;
+        const uint64_t bytes = allocatedBytes() - startBytes;
+        std::lock_guard<std::mutex> lock(allocRegistryMutex());
+        Stat& stat = allocRegistry()[name];
+        stat.calls++;
+        stat.allocations += allocations;
+        stat.bytes += bytes;
+    }
+
+    std::map<std::string, Stat> snapshot() {
+        std::lock_guard<std::mutex> lock(allocRegistryMutex());
+        return allocRegistry();
+    }
+
+    void printReport(std::ostream& out) {
+        const auto stats = snapshot();
+        out << "Операция" << std::string(28, ' ')
+            << "   Вызовов" << "    Выделений" << "        Байт" << "  Выдел./вызов" << "\n";
+        for (const auto& entry : stats) {
+            const Stat& stat = entry.second;
+            out << std::left << std::setw(36) << entry.first << std::right
+                << std::setw(10) << stat.calls
+                << std::setw(13) << stat.allocations
+                << std::setw(12) << stat.bytes
+                << std::setw(14) << std::fixed << std::setprecision(1)
+                << static_cast<double>(stat.allocations) / static_cast<double>(stat.calls) << "\n";
         }
     }
 
-    file.close();
-    return file.good();
+    void reset() {
+        std::lock_guard<std::mutex> lock(allocRegistryMutex());
+        allocRegistry().clear();
+    }
 }
 
-bool FileHandler::loadFromBinary(Collection<Car>& collection, const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
-        return false;
+//  CarKey реализация 
+CarKey CarKey::of(const Car& car) {
+    return CarKey{ car.getManufacturer(), car.getModel(), car.getYear(),
+        car.getScale(), car.getColor() };
+}
+
+bool CarKey::operator==(const CarKey& other) const {
+    return year == other.year &&
+        manufacturer == other.manufacturer &&
+        model == other.model &&
+        scale == other.scale &&
+        color == other.color;
+}
+
+size_t CarKeyHash::operator()(const CarKey& key) const {
+    return static_cast<size_t>(HashUtils::hashIdentity(key.manufacturer, key.model,
+        key.year, key.scale, key.color));
+}
+
+//  CompactCar реализация 
+StringPool::StringPool(const StringPool& other) : values(other.values) {
+    ids.reserve(values.size());
+    for (size_t id = 0; id < values.size(); ++id) {
+        ids.emplace(values[id], static_cast<uint32_t>(id));
     }
+}
 
-    size_t size;
-    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+StringPool& StringPool::operator=(const StringPool& other) {
+    if (this != &other) {
+        StringPool copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
 
-    for (size_t i = 0; i < size; ++i) {
-        size_t manufSize;
-        file.read(reinterpret_cast<char*>(&manufSize), sizeof(manufSize));
-        std::string manufacturer(manufSize, '\0');
-        file.read(&manufacturer[0], manufSize);
+uint32_t StringPool::intern(std::string_view value) {
+    auto found = ids.find(value);
+    if (found != ids.end()) {
+        return found->second;
+    }
+    if (values.size() >= UINT32_MAX) {
+        throw std::length_error("String pool is full");
+    }
+    const uint32_t id = static_cast<uint32_t>(values.size());
+    values.emplace_back(value);
+    ids.emplace(values.back(), id);
+    return id;
+}
 
-        size_t modelSize;
-        file.read(reinterpret_cast<char*>(&modelSize), sizeof(modelSize));
-        std::string model(modelSize, '\0');
-        file.read(&model[0], modelSize);
+std::optional<uint32_t> StringPool::find(std::string_view value) const {
+    auto found = ids.find(value);
+    if (found == ids.end()) {
+        return std::nullopt;
+    }
+    return found->second;
+}
 
-        int year;
-        double price;
-        CarType type;
-        Condition condition;
+CompactCar CompactCar::fromCar(const Car& car, StringPool& pool) {
+    if (car.getYear() < 0 || car.getYear() > UINT16_MAX) {
+        throw std::invalid_argument("Year does not fit compact record: " + std::to_string(car.getYear()));
+    }
+    CompactCar record{};
+    record.priceKopecks = car.getPriceMoney().kopecks();
+    record.manufacturer = pool.intern(car.getManufacturer());
+    record.model = pool.intern(car.getModel());
+    record.scale = pool.intern(car.getScale());
+    record.color = pool.intern(car.getColor());
+    record.year = static_cast<uint16_t>(car.getYear());
+    record.type = static_cast<uint8_t>(car.getType());
+    record.condition = static_cast<uint8_t>(car.getCondition());
+    record.limitedEdition = car.isLimitedEdition() ? 1 : 0;
+    return record;
+}
 
-        file.read(reinterpret_cast<char*>(&year), sizeof(year));
-        file.read(reinterpret_cast<char*>(&price), sizeof(price));
-        file.read(reinterpret_cast<char*>(&type), sizeof(type));
-        file.read(reinterpret_cast<char*>(&condition), sizeof(condition));
+Car CompactCar::toCar(const StringPool& pool) const {
+    return Car(pool.str(manufacturer), pool.str(model), year, getPriceMoney(),
+        getType(), getCondition(), pool.str(scale), pool.str(color), limitedEdition != 0);
+}
 
-        size_t scaleSize;
-        file.read(reinterpret_cast<char*>(&scaleSize), sizeof(scaleSize));
-        std::string scale(scaleSize, '\0');
-        file.read(&scale[0], scaleSize);
+void CompactCarTable::addAll(const Collection<Car>& collection) {
+    rows.reserve(rows.size() + collection.size());
+    for (const auto& car : collection) {
+        add(*car);
+    }
+}
 
-        size_t colorSize;
-        file.read(reinterpret_cast<char*>(&colorSize), sizeof(colorSize));
-        std::string color(colorSize, '\0');
-        file.read(&color[0], colorSize);
+Collection<Car> CompactCarTable::toCollection(const std::string& name) const {
+    Collection<Car> collection(name);
+    collection.reserve(rows.size());
+    for (const auto& row : rows) {
+        collection.emplaceItem(row.toCar(pool));
+    }
+    return collection;
+}
 
-        bool limitedEdition;
-        file.read(reinterpret_cast<char*>(&limitedEdition), sizeof(limitedEdition));
+std::vector<size_t> CompactCarTable::findByManufacturer(const std::string& manufacturer) const {
+    PROFILE_SCOPE("compact.findByManufacturer");
+    std::vector<size_t> result;
+    auto id = pool.find(manufacturer);
+    if (!id) {
+        return result;
+    }
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (rows[i].manufacturer == *id) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+std::vector<size_t> CompactCarTable::filterByCondition(Condition condition) const {
+    PROFILE_SCOPE("compact.filterByCondition");
+    std::vector<size_t> result;
+    const uint8_t wanted = static_cast<uint8_t>(condition);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (rows[i].condition == wanted) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
 
-        auto car = std::make_shared<Car>(manufacturer, model, year, price,
-            type, condition, scale, color, limitedEdition);
-        collection.addItem(car);
+std::vector<size_t> CompactCarTable::filterByType(CarType type) const {
+    PROFILE_SCOPE("compact.filterByType");
+    std::vector<size_t> result;
+    const uint8_t wanted = static_cast<uint8_t>(type);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (rows[i].type == wanted) {
+            result.push_back(i);
+        }
     }
+    return result;
+}
 
-    file.close();
-    return file.good();
-}
\ No newline at end of file
+int64_t CompactCarTable::totalValueKopecks() const {
+    PROFILE_SCOPE("compact.totalValue");
+    int64_t total = 0;
+    for (const auto& row : rows) {
+        total += row.priceKopecks;
+    }
+    return total;
+}
+
+//  TextUtils реализация 
+std::u32string TextUtils::decodeUtf8(const std::string& str) {
+    std::u32string result;
+    result.reserve(str.size());
+    for (size_t i = 0; i < str.size();) {
+        const unsigned char lead = static_cast<unsigned char>(str[i]);
+        size_t length = 1;
+        char32_t cp = lead;
+        if (lead >= 0xF0) {
+            length = 4;
+            cp = lead & 0x07;
+        }
+        else if (lead >= 0xE0) {
+            length = 3;
+            cp = lead & 0x0F;
+        }
+        else if (lead >= 0xC0) {
+            length = 2;
+            cp = lead & 0x1F;
+        }
+        if (i + length > str.size()) {
+            // Обрезанная последовательность: оставляем байт как есть
+            result.push_back(lead);
+            ++i;
+            continue;
+        }
+        for (size_t k = 1; k < length; ++k) {
+            cp = (cp << 6) | (static_cast<unsigned char>(str[i + k]) & 0x3F);
+        }
+        result.push_back(cp);
+        i += length;
+    }
+    return result;
+}
+
+std::u32string TextUtils::foldCase(const std::string& str) {
+    std::u32string result = decodeUtf8(str);
+    for (auto& cp : result) {
+        if (cp >= U'A' && cp <= U'Z') {
+            cp += 0x20;
+        }
+        else if (cp >= 0x0410 && cp <= 0x042F) {   // А..Я
+            cp += 0x20;
+        }
+        else if (cp >= 0x0400 && cp <= 0x040F) {   // Ё, Ђ, ... Џ
+            cp += 0x50;
+        }
+    }
+    return result;
+}
+
+size_t TextUtils::levenshtein(const std::u32string& a, const std::u32string& b) {
+    std::vector<size_t> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) {
+        row[j] = j;
+    }
+    for (size_t i = 1; i <= a.size(); ++i) {
+        size_t diagonal = row[0];
+        row[0] = i;
+        for (size_t j = 1; j <= b.size(); ++j) {
+            const size_t above = row[j];
+            row[j] = std::min({ above + 1, row[j - 1] + 1,
+                diagonal + (a[i - 1] == b[j - 1] ? 0 : 1) });
+            diagonal = above;
+        }
+    }
+    return row[b.size()];
+}
+
+//  TextIndex реализация 
+uint64_t TextIndex::trigramKey(char32_t a, char32_t b, char32_t c) {
+    return (static_cast<uint64_t>(a) << 42) | (static_cast<uint64_t>(b) << 21) | c;
+}
+
+void TextIndex::build(const Collection<Car>& collection) {
+    PROFILE_SCOPE("textIndex.build");
+    terms.clear();
+    originals.clear();
+    bkTree.clear();
+    postings.clear();
+    sortedTerms.clear();
+    trigrams.clear();
+
+    std::unordered_map<std::string, uint32_t> termIds;
+    auto addTerm = [&](const std::string& value, size_t row) {
+        auto inserted = termIds.emplace(value, static_cast<uint32_t>(terms.size()));
+        if (inserted.second) {
+            terms.push_back(TextUtils::foldCase(value));
+            originals.push_back(value);
+            postings.emplace_back();
+        }
+        auto& rows = postings[inserted.first->second];
+        if (rows.empty() || rows.back() != row) {
+            rows.push_back(row);
+        }
+    };
+
+    size_t row = 0;
+    for (const auto& car : collection) {
+        addTerm(car->getManufacturer(), row);
+        addTerm(car->getModel(), row);
+        ++row;
+    }
+
+    // Разные исходные написания ("BMW"/"bmw") дают одинаковый терм - это допустимо,
+    // строки объединяются при выдаче результатов
+    sortedTerms.resize(terms.size());
+    for (uint32_t id = 0; id < terms.size(); ++id) {
+        sortedTerms[id] = id;
+        const auto& term = terms[id];
+        for (size_t i = 0; i + 2 < term.size(); ++i) {
+            auto& list = trigrams[trigramKey(term[i], term[i + 1], term[i + 2])];
+            if (list.empty() || list.back() != id) {
+                list.push_back(id);
+            }
+        }
+    }
+    std::sort(sortedTerms.begin(), sortedTerms.end(),
+        [this](uint32_t a, uint32_t b) { return terms[a] < terms[b]; });
+    buildBkTree();
+
+    builtVersion = collection.getVersion();
+    builtSize = collection.size();
+    built = true;
+}
+
+bool TextIndex::isStale(const Collection<Car>& collection) const {
+    return !built || builtVersion != collection.getVersion() || builtSize != collection.size();
+}
+
+std::vector<size_t> TextIndex::findPrefix(const std::string& query) const {
+    const std::u32string folded = TextUtils::foldCase(query);
+    auto first = std::lower_bound(sortedTerms.begin(), sortedTerms.end(), folded,
+        [this](uint32_t id, const std::u32string& value) { return terms[id] < value; });
+
+    std::vector<uint32_t> matched;
+    for (auto it = first; it != sortedTerms.end(); ++it) {
+        const auto& term = terms[*it];
+        if (term.compare(0, folded.size(), folded) != 0) {
+            break;
+        }
+        matched.push_back(*it);
+    }
+    return collectRows(matched);
+}
+
+std::vector<size_t> TextIndex::findSubstring(const std::string& query) const {
+    const std::u32string folded = TextUtils::foldCase(query);
+    std::vector<uint32_t> matched;
+
+    if (folded.size() < 3) {
+        // Короткий запрос: просмотр словаря, он намного меньше коллекции
+        for (uint32_t id = 0; id < terms.size(); ++id) {
+            if (terms[id].find(folded) != std::u32string::npos) {
+                matched.push_back(id);
+            }
+        }
+        return collectRows(matched);
+    }
+
+    // Кандидаты - термы, содержащие самую редкую триграмму запроса
+    const std::vector<uint32_t>* rarest = nullptr;
+    for (size_t i = 0; i + 2 < folded.size(); ++i) {
+        auto it = trigrams.find(trigramKey(folded[i], folded[i + 1], folded[i + 2]));
+        if (it == trigrams.end()) {
+            return {};
+        }
+        if (!rarest || it->second.size() < rarest->size()) {
+            rarest = &it->second;
+        }
+    }
+
+    for (uint32_t id : *rarest) {
+        if (terms[id].find(folded) != std::u32string::npos) {
+            matched.push_back(id);
+        }
+    }
+    return collectRows(matched);
+}
+
+void TextIndex::buildBkTree() {
+    bkTree.clear();
+    bkTree.reserve(terms.size());
+    for (uint32_t id = 0; id < terms.size(); ++id) {
+        if (bkTree.empty()) {
+            bkTree.push_back(BkNode{ id, {} });
+            continue;
+        }
+
+        size_t node = 0;
+        while (true) {
+            const uint32_t distance = static_cast<uint32_t>(
+                TextUtils::levenshtein(terms[id], terms[bkTree[node].term]));
+            auto& children = bkTree[node].children;
+            auto child = std::find_if(children.begin(), children.end(),
+                [distance](const std::pair<uint32_t, uint32_t>& edge) { return edge.first == distance; });
+            if (child == children.end()) {
+                children.emplace_back(distance, static_cast<uint32_t>(bkTree.size()));
+                bkTree.push_back(BkNode{ id, {} });
+                break;
+            }
+            node = child->second;
+        }
+    }
+}
+
+std::vector<FuzzyMatch> TextIndex::findFuzzy(const std::string& query, size_t maxDistance) const {
+    std::vector<FuzzyMatch> matches;
+    if (bkTree.empty()) {
+        return matches;
+    }
+
+    const std::u32string folded = TextUtils::foldCase(query);
+    std::vector<std::pair<uint32_t, size_t>> found; // терм, расстояние
+    std::vector<size_t> pending{ 0 };
+    while (!pending.empty()) {
+        const BkNode& node = bkTree[pending.back()];
+        pending.pop_back();
+
+        const size_t distance = TextUtils::levenshtein(folded, terms[node.term]);
+        if (distance <= maxDistance) {
+            found.emplace_back(node.term, distance);
+        }
+        // Неравенство треугольника: искомые термы лежат только в поддеревьях
+        // с ребрами из [distance - maxDistance, distance + maxDistance]
+        const size_t low = distance > maxDistance ? distance - maxDistance : 0;
+        const size_t high = distance + maxDistance;
+        for (const auto& edge : node.children) {
+            if (edge.first >= low && edge.first <= high) {
+                pending.push_back(edge.second);
+            }
+        }
+    }
+
+    for (const auto& hit : found) {
+        matches.push_back(FuzzyMatch{ originals[hit.first], hit.second, postings[hit.first] });
+    }
+    std::sort(matches.begin(), matches.end(), [](const FuzzyMatch& a, const FuzzyMatch& b) {
+        if (a.distance != b.distance) return a.distance < b.distance;
+        if (a.rows.size() != b.rows.size()) return a.rows.size() > b.rows.size();
+        return a.term < b.term;
+    });
+    return matches;
+}
+
+std::vector<size_t> TextIndex::collectRows(const std::vector<uint32_t>& termIds) const {
+    std::vector<size_t> rows;
+    for (uint32_t id : termIds) {
+        rows.insert(rows.end(), postings[id].begin(), postings[id].end());
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    return rows;
+}
+
+//  FileHandler реализация 
+bool FileHandler::exportToCSV(const Collection<Car>& collection, const std::string& filename) {
+    return exportToCSV(collection.snapshot(), filename);
+}
+
+bool FileHandler::exportToCSV(const CollectionSnapshot<Car>& collection, const std::string& filename) {
+    PROFILE_SCOPE("csv.export");
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
+        return false;
+    }
+
+    // Заголовок и данные CSV на английском
+    writeCSVHeader(file);
+    for (const auto& carPtr : collection) {
+        const Car* car = dynamic_cast<Car*>(carPtr.get());
+        if (car) {
+            writeCSVRow(file, *car);
+        }
+    }
+
+    file.close();
+    return file.good();
+}
+
+void FileHandler::writeCSVHeader(std::ostream& out) {
+    out << "Manufacturer;Model;Year;Price;Type;Condition;Scale;Color;LimitedEdition\n";
+}
+
+void FileHandler::writeCSVRow(std::ostream& out, const Car& car) {
+    out << car.getManufacturer() << ";"
+        << car.getModel() << ";"
+        << car.getYear() << ";"
+        << car.getPriceMoney() << ";"
+        << EnumUtils::carTypeToStrEN(car.getType()) << ";"
+        << EnumUtils::conditionToStrEN(car.getCondition()) << ";"
+        << car.getScale() << ";"
+        << car.getColor() << ";"
+        << (car.isLimitedEdition() ? "Yes" : "No") << "\n";
+}
+
+namespace {
+    // Цена из CSV: точная десятичная запись, иначе (например, "1e3") - через double
+    Money parsePrice(const std::string& text) {
+        if (auto exact = Money::parse(text)) {
+            return *exact;
+        }
+        return Money::fromDouble(std::stod(text));
+    }
+
+    uint64_t remainingBytes(std::ifstream& file) {
+        const std::streamoff start = file.tellg();
+        file.seekg(0, std::ios::end);
+        const std::streamoff end = file.tellg();
+        file.seekg(start);
+        return start >= 0 && end > start ? static_cast<uint64_t>(end - start) : 0;
+    }
+
+    // Проверка отмены и отчеты о ходе загрузки для LoadOptions
+    class LoadTracker {
+    public:
+        LoadTracker(const LoadOptions& options, uint64_t bytesTotal)
+            : options(options), bytesTotal(bytesTotal), started(std::chrono::steady_clock::now()) {
+        }
+
+        size_t batchRows() const { return options.batchRows ? options.batchRows : 1; }
+        bool cancelled() const { return options.cancel && options.cancel->cancelled(); }
+
+        void report(uint64_t bytesDone, size_t rows, size_t skippedRows = 0) const {
+            if (!options.onProgress) {
+                return;
+            }
+            LoadProgress progress;
+            progress.bytesDone = std::min(bytesDone, bytesTotal);
+            progress.bytesTotal = bytesTotal;
+            progress.rows = rows;
+            progress.skippedRows = skippedRows;
+            progress.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            options.onProgress(progress);
+        }
+
+    private:
+        const LoadOptions& options;
+        uint64_t bytesTotal;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    bool reportCancelled(const std::string& filename) {
+        std::cerr << "Чтение файла " << filename << " отменено\n";
+        return false;
+    }
+
+    // Число записей берется из файла, поэтому резерв ограничен тем,
+    // сколько записей минимального размера помещается в остаток файла
+    size_t legacyRecordHint(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        size_t size = 0;
+        file.read(reinterpret_cast<char*>(&size), sizeof(size));
+        const uint64_t dataBytes = file ? remainingBytes(file) : 0;
+        const size_t minRecordBytes = 4 * sizeof(size_t) + sizeof(int) + sizeof(double)
+            + sizeof(CarType) + sizeof(Condition) + sizeof(bool);
+        return static_cast<size_t>(std::min<uint64_t>(size, dataBytes / minRecordBytes));
+    }
+
+    bool isBlockFile(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        char magic[sizeof(FileHandler::BLOCK_MAGIC)] = {};
+        file.read(magic, sizeof(magic));
+        return file && std::memcmp(magic, FileHandler::BLOCK_MAGIC, sizeof(magic)) == 0;
+    }
+}
+
+bool FileHandler::importFromCSV(Collection<Car>& collection, const std::string& filename) {
+    return importFromCSV(collection, filename, LoadOptions());
+}
+
+bool FileHandler::importFromCSV(Collection<Car>& collection, const std::string& filename,
+    const LoadOptions& options) {
+    PROFILE_SCOPE("csv.import");
+    std::vector<std::shared_ptr<Car>> cars;
+    if (!scanCSV(filename, [&cars](std::shared_ptr<Car> car) { cars.push_back(std::move(car)); }, options)) {
+        return false;
+    }
+    TRACE_SCOPE("collection.append");
+    collection.addItems(std::move(cars));
+    return true;
+}
+
+bool FileHandler::scanCSV(const std::string& filename, const CarVisitor& visit, const LoadOptions& options) {
+    // Двоичный режим: длина строки вместе с переводом строки равна числу
+    // прочитанных байт на любой платформе, \r из CRLF отбрасывается вручную
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
+        return false;
+    }
+    LoadTracker tracker(options, remainingBytes(file));
+
+    std::string line;
+    // Пропускаем заголовок
+    if (!std::getline(file, line)) {
+        std::cerr << "Файл пуст или не содержит заголовка\n";
+        return false;
+    }
+
+    TRACE_ACCUMULATOR(parsePhase, "csv.import.parse");
+    TRACE_ACCUMULATOR(buildPhase, "csv.import.build_row");
+
+    uint64_t bytesRead = line.size() + 1;
+    int lineNum = 1;
+    size_t skipped = 0;
+    while (std::getline(file, line)) {
+        lineNum++;
+        bytesRead += line.size() + 1;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if ((lineNum - 1) % tracker.batchRows() == 0) {
+            if (tracker.cancelled()) {
+                return reportCancelled(filename);
+            }
+            tracker.report(bytesRead, lineNum - 1, skipped);
+        }
+
+        std::vector<std::string> tokens;
+        {
+            TRACE_ACCUMULATE(parsePhase);
+            std::stringstream ss(line);
+            std::string token;
+            while (std::getline(ss, token, ';')) {
+                tokens.push_back(token);
+            }
+        }
+
+        if (tokens.size() == 9) {
+            std::shared_ptr<Car> car;
+            try {
+                TRACE_ACCUMULATE(buildPhase);
+                car = std::make_shared<Car>(
+                    std::move(tokens[0]), // manufacturer
+                    std::move(tokens[1]), // model
+                    std::stoi(tokens[2]), // year
+                    parsePrice(tokens[3]), // price
+                    EnumUtils::stringToCarType(tokens[4]), // type
+                    EnumUtils::stringToCondition(tokens[5]), // condition
+                    std::move(tokens[6]), // scale
+                    std::move(tokens[7]), // color
+                    tokens[8] == "Yes" || tokens[8] == "1" // limitedEdition
+                );
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Ошибка парсинга строки " << lineNum << ": " << line
+                    << " - " << e.what() << std::endl;
+                skipped++;
+                continue;
+            }
+            visit(std::move(car));
+        }
+        else {
+            std::cerr << "Неверное количество полей в строке " << lineNum
+                << ": " << tokens.size() << " вместо 9\n";
+            skipped++;
+        }
+    }
+
+    if (tracker.cancelled()) {
+        return reportCancelled(filename);
+    }
+    tracker.report(bytesRead, lineNum - 1, skipped);
+
+    TRACE_COUNTER("csv.import.lines", lineNum - 1);
+    return true;
+}
+
+bool FileHandler::saveToBinary(const Collection<Car>& collection, const std::string& filename) {
+    return saveToBinary(collection.snapshot(), filename);
+}
+
+bool FileHandler::saveToBinary(const CollectionSnapshot<Car>& collection, const std::string& filename) {
+    PROFILE_SCOPE("binary.save");
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
+        return false;
+    }
+
+    size_t size = collection.size();
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+
+    for (const auto& carPtr : collection) {
+        const Car* car = dynamic_cast<Car*>(carPtr.get());
+        if (car) {
+            std::string manufacturer = car->getManufacturer();
+            std::string model = car->getModel();
+            int year = car->getYear();
+            double price = car->getPrice();
+            CarType type = car->getType();
+            Condition condition = car->getCondition();
+            std::string scale = car->getScale();
+            std::string color = car->getColor();
+            bool limitedEdition = car->isLimitedEdition();
+
+            size_t manufSize = manufacturer.size();
+            file.write(reinterpret_cast<const char*>(&manufSize), sizeof(manufSize));
+            file.write(manufacturer.c_str(), manufSize);
+
+            size_t modelSize = model.size();
+            file.write(reinterpret_cast<const char*>(&modelSize), sizeof(modelSize));
+            file.write(model.c_str(), modelSize);
+
+            file.write(reinterpret_cast<const char*>(&year), sizeof(year));
+            file.write(reinterpret_cast<const char*>(&price), sizeof(price));
+            file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+            file.write(reinterpret_cast<const char*>(&condition), sizeof(condition));
+
+            size_t scaleSize = scale.size();
+            file.write(reinterpret_cast<const char*>(&scaleSize), sizeof(scaleSize));
+            file.write(scale.c_str(), scaleSize);
+
+            size_t colorSize = color.size();
+            file.write(reinterpret_cast<const char*>(&colorSize), sizeof(colorSize));
+            file.write(color.c_str(), colorSize);
+
+            file.write(reinterpret_cast<const char*>(&limitedEdition), sizeof(limitedEdition));
+        }
+    }
+
+    file.close();
+    return file.good();
+}
+
+bool FileHandler::loadFromBinary(Collection<Car>& collection, const std::string& filename,
+    unsigned threadCount) {
+    LoadOptions options;
+    options.threadCount = threadCount;
+    return loadFromBinary(collection, filename, options);
+}
+
+bool FileHandler::loadFromBinary(Collection<Car>& collection, const std::string& filename,
+    const LoadOptions& options) {
+    PROFILE_SCOPE("binary.load");
+    if (isBlockFile(filename)) {
+        return loadFromBlockBinary(collection, filename, options);
+    }
+
+    std::vector<std::shared_ptr<Car>> cars;
+    cars.reserve(legacyRecordHint(filename));
+    if (!scanBinary(filename, [&cars](std::shared_ptr<Car> car) { cars.push_back(std::move(car)); }, options)) {
+        return false;
+    }
+    TRACE_SCOPE("collection.append");
+    collection.addItems(std::move(cars));
+    return true;
+}
+
+bool FileHandler::scanBinary(const std::string& filename, const CarVisitor& visit, const LoadOptions& options) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
+        return false;
+    }
+
+    // Блочный формат узнаём по сигнатуре в начале файла
+    char magic[sizeof(BLOCK_MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    if (file && std::memcmp(magic, BLOCK_MAGIC, sizeof(magic)) == 0) {
+        file.close();
+        return scanBlockBinary(filename, visit, options);
+    }
+    file.clear();
+    file.seekg(0);
+    LoadTracker tracker(options, remainingBytes(file));
+
+    size_t size;
+    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+
+    size_t i = 0;
+    for (; file && i < size; ++i) {
+        if (i % tracker.batchRows() == 0) {
+            if (tracker.cancelled()) {
+                return reportCancelled(filename);
+            }
+            tracker.report(static_cast<uint64_t>(file.tellg()), i);
+        }
+
+        size_t manufSize;
+        file.read(reinterpret_cast<char*>(&manufSize), sizeof(manufSize));
+        std::string manufacturer(manufSize, '\0');
+        file.read(&manufacturer[0], manufSize);
+
+        size_t modelSize;
+        file.read(reinterpret_cast<char*>(&modelSize), sizeof(modelSize));
+        std::string model(modelSize, '\0');
+        file.read(&model[0], modelSize);
+
+        int year;
+        double price;
+        CarType type;
+        Condition condition;
+
+        file.read(reinterpret_cast<char*>(&year), sizeof(year));
+        file.read(reinterpret_cast<char*>(&price), sizeof(price));
+        file.read(reinterpret_cast<char*>(&type), sizeof(type));
+        file.read(reinterpret_cast<char*>(&condition), sizeof(condition));
+
+        size_t scaleSize;
+        file.read(reinterpret_cast<char*>(&scaleSize), sizeof(scaleSize));
+        std::string scale(scaleSize, '\0');
+        file.read(&scale[0], scaleSize);
+
+        size_t colorSize;
+        file.read(reinterpret_cast<char*>(&colorSize), sizeof(colorSize));
+        std::string color(colorSize, '\0');
+        file.read(&color[0], colorSize);
+
+        bool limitedEdition;
+        file.read(reinterpret_cast<char*>(&limitedEdition), sizeof(limitedEdition));
+
+        if (file) {
+            visit(std::make_shared<Car>(std::move(manufacturer), std::move(model), year, price,
+                type, condition, std::move(scale), std::move(color), limitedEdition));
+        }
+    }
+
+    if (!file) {
+        std::cerr << "Файл поврежден или обрезан: " << filename << std::endl;
+        return false;
+    }
+    if (tracker.cancelled()) {
+        return reportCancelled(filename);
+    }
+    tracker.report(static_cast<uint64_t>(file.tellg()), i);
+    return true;
+}
+//  Блочный бинарный формат
+//
+//  [magic 8][recordCount u64][blockRecords u32][blockCount u32]
+//  [blockCount x (offset u64, size u64)]
+//  [блоки: записи с длинами строк u32, year i32, price f64, type/condition/limited u8]
+namespace {
+    unsigned resolveThreadCount(unsigned requested, size_t blockCount) {
+        unsigned threads = requested ? requested : std::thread::hardware_concurrency();
+        if (threads == 0) {
+            threads = 1;
+        }
+        if (blockCount < threads) {
+            threads = static_cast<unsigned>(blockCount ? blockCount : 1);
+        }
+        return threads;
+    }
+
+    // Выполняет job(i) для всех i < count в threads потоках.
+    // Первое исключение из рабочего потока пробрасывается вызывающему.
+    void parallelFor(size_t count, unsigned threads, const std::function<void(size_t)>& job) {
+        if (threads <= 1) {
+            for (size_t i = 0; i < count; ++i) {
+                job(i);
+            }
+            return;
+        }
+
+        std::atomic<size_t> next(0);
+        std::atomic<bool> failed(false);
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        auto worker = [&]() {
+            size_t i;
+            while (!failed && (i = next++) < count) {
+                try {
+                    job(i);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    failed = true;
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; ++t) {
+            pool.emplace_back(worker);
+        }
+        for (auto& thread : pool) {
+            thread.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    template<typename V>
+    void putValue(std::string& out, V value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void putString(std::string& out, const std::string& str) {
+        putValue<uint32_t>(out, static_cast<uint32_t>(str.size()));
+        out.append(str);
+    }
+
+    class BlockReader {
+    public:
+        BlockReader(const char* data, size_t size) : pos(data), end(data + size) {}
+
+        template<typename V>
+        V get() {
+            require(sizeof(V));
+            V value;
+            std::memcpy(&value, pos, sizeof(V));
+            pos += sizeof(V);
+            return value;
+        }
+
+        std::string getString() {
+            uint32_t length = get<uint32_t>();
+            require(length);
+            std::string str(pos, length);
+            pos += length;
+            return str;
+        }
+
+        bool atEnd() const { return pos == end; }
+
+    private:
+        void require(size_t bytes) const {
+            if (static_cast<size_t>(end - pos) < bytes) {
+                throw std::runtime_error("Блок повреждён: неожиданный конец данных");
+            }
+        }
+
+        const char* pos;
+        const char* end;
+    };
+
+    void encodeCar(std::string& out, const Car& car) {
+        putString(out, car.getManufacturer());
+        putString(out, car.getModel());
+        putValue<int32_t>(out, car.getYear());
+        putValue<double>(out, car.getPrice());
+        putValue<uint8_t>(out, static_cast<uint8_t>(car.getType()));
+        putValue<uint8_t>(out, static_cast<uint8_t>(car.getCondition()));
+        putString(out, car.getScale());
+        putString(out, car.getColor());
+        putValue<uint8_t>(out, car.isLimitedEdition() ? 1 : 0);
+    }
+
+    std::shared_ptr<Car> decodeCar(BlockReader& reader) {
+        std::string manufacturer = reader.getString();
+        std::string model = reader.getString();
+        int year = reader.get<int32_t>();
+        double price = reader.get<double>();
+        uint8_t type = reader.get<uint8_t>();
+        uint8_t condition = reader.get<uint8_t>();
+        std::string scale = reader.getString();
+        std::string color = reader.getString();
+        bool limitedEdition = reader.get<uint8_t>() != 0;
+
+        if (type > static_cast<uint8_t>(CarType::CUSTOM_BUILD) ||
+            condition > static_cast<uint8_t>(Condition::POOR)) {
+            throw std::runtime_error("Блок повреждён: неизвестный тип или состояние");
+        }
+
+        return std::make_shared<Car>(manufacturer, model, year, price,
+            static_cast<CarType>(type), static_cast<Condition>(condition),
+            scale, color, limitedEdition);
+    }
+
+    struct BlockTable {
+        uint64_t recordCount = 0;
+        uint32_t blockRecords = 0;
+        uint32_t blockCount = 0;
+        std::vector<uint64_t> entries;  // смещение и размер каждого блока
+        uint64_t headerBytes = 0;       // заголовок вместе с таблицей
+        uint64_t fileBytes = 0;
+    };
+
+    bool readBlockTable(const std::string& filename, BlockTable& table) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Ошибка открытия файла: " << filename << std::endl;
+            return false;
+        }
+        table.fileBytes = remainingBytes(file);
+
+        char magic[sizeof(FileHandler::BLOCK_MAGIC)];
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char*>(&table.recordCount), sizeof(table.recordCount));
+        file.read(reinterpret_cast<char*>(&table.blockRecords), sizeof(table.blockRecords));
+        file.read(reinterpret_cast<char*>(&table.blockCount), sizeof(table.blockCount));
+
+        if (!file || std::memcmp(magic, FileHandler::BLOCK_MAGIC, sizeof(magic)) != 0 || table.blockRecords == 0 ||
+            table.blockCount != (table.recordCount + table.blockRecords - 1) / table.blockRecords) {
+            std::cerr << "Неверный заголовок блочного файла: " << filename << std::endl;
+            return false;
+        }
+
+        // Размеры из заголовка сверяются с файлом до выделения памяти:
+        // поврежденный счетчик не должен приводить к bad_alloc.
+        // Каждая запись занимает в блоке хотя бы один байт
+        const uint64_t tableBytes = static_cast<uint64_t>(table.blockCount) * 2 * sizeof(uint64_t);
+        table.headerBytes = static_cast<uint64_t>(file.tellg()) + tableBytes;
+        if (table.headerBytes > table.fileBytes || table.recordCount > table.fileBytes - table.headerBytes) {
+            std::cerr << "Неверный заголовок блочного файла: " << filename << std::endl;
+            return false;
+        }
+
+        table.entries.resize(static_cast<size_t>(table.blockCount) * 2);
+        file.read(reinterpret_cast<char*>(table.entries.data()), tableBytes);
+        if (!file) {
+            std::cerr << "Таблица блоков повреждена: " << filename << std::endl;
+            return false;
+        }
+        for (uint32_t block = 0; block < table.blockCount; ++block) {
+            const uint64_t offset = table.entries[block * 2];
+            const uint64_t size = table.entries[block * 2 + 1];
+            if (offset < table.headerBytes || offset > table.fileBytes || size > table.fileBytes - offset) {
+                std::cerr << "Таблица блоков повреждена: " << filename << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Читает блок через собственный поток файла, поэтому безопасна из нескольких потоков
+    std::vector<std::shared_ptr<Car>> decodeBlock(const std::string& filename, const BlockTable& table,
+        size_t block) {
+        TRACE_SCOPE("binary.decode_block");
+        std::ifstream in(filename, std::ios::binary);
+        const size_t from = block * table.blockRecords;
+        const size_t to = std::min<size_t>(from + table.blockRecords, table.recordCount);
+        std::string buffer(static_cast<size_t>(table.entries[block * 2 + 1]), '\0');
+        in.seekg(static_cast<std::streamoff>(table.entries[block * 2]));
+        in.read(&buffer[0], buffer.size());
+        if (!in) {
+            throw std::runtime_error("не удалось прочитать блок " + std::to_string(block));
+        }
+
+        BlockReader reader(buffer.data(), buffer.size());
+        std::vector<std::shared_ptr<Car>> cars;
+        cars.reserve(to > from ? to - from : 0);
+        for (size_t r = from; r < to; ++r) {
+            cars.push_back(decodeCar(reader));
+        }
+        if (!reader.atEnd()) {
+            throw std::runtime_error("лишние данные в блоке " + std::to_string(block));
+        }
+        return cars;
+    }
+}
+
+bool FileHandler::saveToBinaryParallel(const Collection<Car>& collection, const std::string& filename,
+    unsigned threadCount) {
+    return saveToBinaryParallel(collection.snapshot(), filename, threadCount);
+}
+
+bool FileHandler::saveToBinaryParallel(const CollectionSnapshot<Car>& collection, const std::string& filename,
+    unsigned threadCount) {
+    PROFILE_SCOPE("binary.save_blocks");
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
+        return false;
+    }
+
+    const uint64_t recordCount = collection.size();
+    const uint32_t blockCount = static_cast<uint32_t>((recordCount + BLOCK_RECORDS - 1) / BLOCK_RECORDS);
+    const unsigned threads = resolveThreadCount(threadCount, blockCount);
+
+    file.write(BLOCK_MAGIC, sizeof(BLOCK_MAGIC));
+    file.write(reinterpret_cast<const char*>(&recordCount), sizeof(recordCount));
+    file.write(reinterpret_cast<const char*>(&BLOCK_RECORDS), sizeof(BLOCK_RECORDS));
+    file.write(reinterpret_cast<const char*>(&blockCount), sizeof(blockCount));
+
+    // Таблица смещений заполняется после записи блоков
+    const std::streamoff tablePos = file.tellp();
+    std::vector<uint64_t> table(static_cast<size_t>(blockCount) * 2, 0);
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(uint64_t));
+
+    // Блоки кодируются волнами, чтобы в памяти не держать весь файл целиком
+    const size_t window = static_cast<size_t>(threads) * 4;
+    std::vector<std::string> buffers(window);
+    auto first = collection.begin();
+
+    try {
+        for (size_t waveStart = 0; waveStart < blockCount; waveStart += window) {
+            const size_t waveSize = std::min<size_t>(window, blockCount - waveStart);
+
+            parallelFor(waveSize, threads, [&](size_t i) {
+                TRACE_SCOPE("binary.encode_block");
+                const size_t block = waveStart + i;
+                const size_t from = block * BLOCK_RECORDS;
+                const size_t to = std::min<size_t>(from + BLOCK_RECORDS, recordCount);
+                std::string& out = buffers[i];
+                out.clear();
+                for (size_t r = from; r < to; ++r) {
+                    encodeCar(out, *first[r]);
+                }
+            });
+
+            for (size_t i = 0; i < waveSize; ++i) {
+                const size_t block = waveStart + i;
+                table[block * 2] = static_cast<uint64_t>(file.tellp());
+                table[block * 2 + 1] = buffers[i].size();
+                file.write(buffers[i].data(), buffers[i].size());
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Ошибка сохранения в файл " << filename << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    file.seekp(tablePos);
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(uint64_t));
+
+    file.close();
+    return file.good();
+}
+
+bool FileHandler::loadFromBlockBinary(Collection<Car>& collection, const std::string& filename,
+    const LoadOptions& options) {
+    PROFILE_SCOPE("binary.load_blocks");
+    BlockTable table;
+    if (!readBlockTable(filename, table)) {
+        return false;
+    }
+    LoadTracker tracker(options, table.fileBytes);
+
+    // Блоки декодируются параллельно, коллекция изменяется только после
+    // успешного декодирования всех блоков.
+    // Отмена проверяется перед каждым блоком, отчет о ходе - после него
+    const unsigned threads = resolveThreadCount(options.threadCount, table.blockCount);
+    std::vector<std::vector<std::shared_ptr<Car>>> decoded(table.blockCount);
+    std::mutex progressMutex;
+    uint64_t bytesDone = table.headerBytes;
+    size_t rowsDone = 0;
+
+    try {
+        parallelFor(table.blockCount, threads, [&](size_t block) {
+            if (tracker.cancelled()) {
+                return;
+            }
+            decoded[block] = decodeBlock(filename, table, block);
+
+            std::lock_guard<std::mutex> lock(progressMutex);
+            bytesDone += table.entries[block * 2 + 1];
+            rowsDone += decoded[block].size();
+            tracker.report(bytesDone, rowsDone);
+        });
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Ошибка загрузки из файла " << filename << ": " << e.what() << std::endl;
+        return false;
+    }
+    if (tracker.cancelled()) {
+        return reportCancelled(filename);
+    }
+
+    TRACE_SCOPE("collection.append");
+    collection.reserve(collection.size() + table.recordCount);
+    for (auto& cars : decoded) {
+        collection.addItems(std::move(cars));
+    }
+    TRACE_COUNTER("binary.load.records", table.recordCount);
+    return true;
+}
+
+// Блоки декодируются группами по числу потоков и передаются visit по порядку:
+// в памяти не больше одной группы
+bool FileHandler::scanBlockBinary(const std::string& filename, const CarVisitor& visit,
+    const LoadOptions& options) {
+    BlockTable table;
+    if (!readBlockTable(filename, table)) {
+        return false;
+    }
+    LoadTracker tracker(options, table.fileBytes);
+
+    const unsigned threads = resolveThreadCount(options.threadCount, table.blockCount);
+    std::vector<std::vector<std::shared_ptr<Car>>> decoded(threads);
+    uint64_t bytesDone = table.headerBytes;
+    size_t rowsDone = 0;
+
+    for (size_t first = 0; first < table.blockCount; first += threads) {
+        if (tracker.cancelled()) {
+            return reportCancelled(filename);
+        }
+        const size_t group = std::min<size_t>(threads, table.blockCount - first);
+        try {
+            parallelFor(group, threads, [&](size_t i) { decoded[i] = decodeBlock(filename, table, first + i); });
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Ошибка чтения файла " << filename << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        for (size_t i = 0; i < group; ++i) {
+            for (auto& car : decoded[i]) {
+                visit(std::move(car));
+            }
+            rowsDone += decoded[i].size();
+            bytesDone += table.entries[(first + i) * 2 + 1];
+            decoded[i].clear();
+        }
+        tracker.report(bytesDone, rowsDone);
+    }
+    return true;
+}
+
+//  Импорт со слиянием
+ImportStats FileHandler::mergeInto(Collection<Car>& target, const Collection<Car>& incoming) {
+    PROFILE_SCOPE("import.merge");
+    ImportStats stats;
+
+    // Индекс существующих машинок по ключу строится один раз: O(N + M).
+    // Значение - строка в target или target.size() + номер среди новых
+    std::unordered_map<CarKey, size_t, CarKeyHash> index;
+    index.reserve(target.size() + incoming.size());
+    size_t position = 0;
+    for (const auto& car : target) {
+        index.emplace(CarKey::of(*car), position++);
+    }
+
+    // Изменения копятся отдельно и применяются одной транзакцией:
+    // одна версия и один пакет событий на весь импорт
+    std::vector<std::shared_ptr<Car>> inserted;
+    std::vector<std::shared_ptr<Car>> replaced(target.size());
+    for (const auto& car : incoming) {
+        auto found = index.find(CarKey::of(*car));
+        if (found == index.end()) {
+            index.emplace(CarKey::of(*car), target.size() + inserted.size());
+            inserted.push_back(car);
+            stats.inserted++;
+            continue;
+        }
+
+        std::shared_ptr<Car>& pending = found->second < target.size() ? replaced[found->second]
+            : inserted[found->second - target.size()];
+        const Car& current = pending ? *pending : *target[found->second];
+        if (current == *car) {
+            stats.skipped++;
+        }
+        else {
+            pending = car;
+            stats.updated++;
+        }
+    }
+
+    Collection<Car>::Transaction transaction(target);
+    for (size_t row = 0; row < replaced.size(); ++row) {
+        if (replaced[row]) {
+            transaction.update(target.handleAt(row), std::move(replaced[row]));
+        }
+    }
+    for (auto& car : inserted) {
+        transaction.insert(std::move(car));
+    }
+    transaction.commit();
+    return stats;
+}
+
+bool FileHandler::mergeFromCSV(Collection<Car>& collection, const std::string& filename,
+    ImportStats& stats, const LoadOptions& options) {
+    Collection<Car> incoming;
+    if (!importFromCSV(incoming, filename, options)) {
+        return false;
+    }
+    stats = mergeInto(collection, incoming);
+    return true;
+}
+
+bool FileHandler::mergeFromBinary(Collection<Car>& collection, const std::string& filename,
+    ImportStats& stats, const LoadOptions& options) {
+    Collection<Car> incoming;
+    if (!loadFromBinary(incoming, filename, options)) {
+        return false;
+    }
+    stats = mergeInto(collection, incoming);
+    return true;
+}
+
+//  AsyncSave реализация 
+AsyncSave::AsyncSave(std::string filename, std::shared_future<SaveReport> result)
+    : filename(std::move(filename)), result(std::move(result)), started(std::chrono::steady_clock::now()) {
+}
+
+AsyncSave AsyncSave::start(const Collection<Car>& collection, const std::string& filename,
+    SaveFormat format) {
+    auto task = [snapshot = collection.snapshot(), filename, format]() {
+        TRACE_SCOPE("save.background");
+        SaveReport report;
+        report.filename = filename;
+        report.records = snapshot.size();
+        const auto begin = std::chrono::steady_clock::now();
+        const std::string temp = filename + ".tmp";
+
+        try {
+            bool written = false;
+            switch (format) {
+            case SaveFormat::CSV:
+                written = FileHandler::exportToCSV(snapshot, temp);
+                break;
+            case SaveFormat::BINARY:
+                written = FileHandler::saveToBinary(snapshot, temp);
+                break;
+            case SaveFormat::BLOCKS:
+                written = FileHandler::saveToBinaryParallel(snapshot, temp);
+                break;
+            }
+
+            if (!written) {
+                report.error = "не удалось записать " + temp;
+                std::remove(temp.c_str());
+            }
+            else {
+                // filesystem::rename заменяет файл одним шагом и на Windows
+                // (MoveFileExW с MOVEFILE_REPLACE_EXISTING): старый файл не удаляется
+                // заранее. Если замена не удалась, новые данные остаются во временном файле
+                std::error_code code;
+                std::filesystem::rename(temp, filename, code);
+                if (code) {
+                    report.error = "не удалось заменить " + filename + " (" + code.message()
+                        + "), новые данные сохранены в " + temp;
+                }
+                else {
+                    std::ifstream saved(filename, std::ios::binary | std::ios::ate);
+                    report.bytes = static_cast<uint64_t>(saved.tellg());
+                    report.success = true;
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            report.error = e.what();
+            std::remove(temp.c_str());
+        }
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        return report;
+    };
+    return AsyncSave(filename, std::async(std::launch::async, std::move(task)).share());
+}
+
+bool AsyncSave::ready() const {
+    return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+double AsyncSave::elapsedSeconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+//  BlockBinaryWriter реализация 
+BlockBinaryWriter::BlockBinaryWriter(const std::string& filename, uint64_t recordCount)
+    : file(filename, std::ios::binary), recordCount(recordCount) {
+    if (!file.is_open()) {
+        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
+        return;
+    }
+
+    const uint32_t blockRecords = FileHandler::BLOCK_RECORDS;
+    const uint32_t blockCount = static_cast<uint32_t>((recordCount + blockRecords - 1) / blockRecords);
+    file.write(FileHandler::BLOCK_MAGIC, sizeof(FileHandler::BLOCK_MAGIC));
+    file.write(reinterpret_cast<const char*>(&recordCount), sizeof(recordCount));
+    file.write(reinterpret_cast<const char*>(&blockRecords), sizeof(blockRecords));
+    file.write(reinterpret_cast<const char*>(&blockCount), sizeof(blockCount));
+
+    tablePos = file.tellp();
+    table.assign(static_cast<size_t>(blockCount) * 2, 0);
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(uint64_t));
+    table.clear();
+}
+
+void BlockBinaryWriter::add(const Car& car) {
+    if (written >= recordCount) {
+        throw std::length_error("Добавлено больше записей, чем объявлено в заголовке");
+    }
+    encodeCar(buffer, car);
+    ++written;
+    if (++bufferedRecords == FileHandler::BLOCK_RECORDS) {
+        flushBlock();
+    }
+}
+
+void BlockBinaryWriter::flushBlock() {
+    table.push_back(static_cast<uint64_t>(file.tellp()));
+    table.push_back(buffer.size());
+    file.write(buffer.data(), buffer.size());
+    buffer.clear();
+    bufferedRecords = 0;
+}
+
+bool BlockBinaryWriter::finish() {
+    if (!file.is_open()) {
+        return false;
+    }
+    if (bufferedRecords > 0) {
+        flushBlock();
+    }
+    file.seekp(tablePos);
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(uint64_t));
+    file.close();
+    return file.good() && written == recordCount;
+}
+
+//  InventoryGenerator реализация 
+namespace {
+    const char* const GENERATOR_MANUFACTURERS[] = {
+        "Ferrari", "Porsche", "Ford", "Chevrolet", "Lamborghini", "Mercedes-Benz",
+        "BMW", "Toyota", "Nissan", "Aston Martin", "Bugatti", "McLaren", "Audi",
+        "Jaguar", "Dodge", "Pagani", "Koenigsegg", "Mazda", "Honda", "Volkswagen",
+        "Alfa Romeo", "Maserati", "Lotus", "Subaru", "Mitsubishi", "Shelby",
+        "Bentley", "Rolls-Royce", "Cadillac", "Pontiac", "ГАЗ", "ВАЗ", "ЗИЛ", "Москвич"
+    };
+    const char* const GENERATOR_SCALES[] = { "1:12", "1:18", "1:24", "1:32", "1:43", "1:64" };
+    const char* const GENERATOR_COLORS[] = {
+        "Red", "Blue", "Black", "White", "Silver", "Yellow", "Green", "Orange"
+    };
+
+    std::vector<double> cumulativeWeights(const std::vector<double>& weights) {
+        std::vector<double> cumulative;
+        double sum = 0.0;
+        for (double w : weights) {
+            sum += w > 0.0 ? w : 0.0;
+            cumulative.push_back(sum);
+        }
+        if (sum <= 0.0) {
+            throw std::invalid_argument("Веса распределения должны быть положительными");
+        }
+        for (double& c : cumulative) {
+            c /= sum;
+        }
+        return cumulative;
+    }
+}
+
+InventoryGenerator::InventoryGenerator(const GeneratorConfig& config)
+    : config(config), state(config.seed) {
+    if (config.manufacturerCount == 0 || config.modelsPerManufacturer == 0 ||
+        config.minYear > config.maxYear || config.minPrice <= 0.0 ||
+        config.minPrice > config.maxPrice) {
+        throw std::invalid_argument("Неверные параметры генератора");
+    }
+
+    const size_t named = sizeof(GENERATOR_MANUFACTURERS) / sizeof(GENERATOR_MANUFACTURERS[0]);
+    std::vector<double> weights;
+    for (size_t i = 0; i < config.manufacturerCount; ++i) {
+        manufacturers.push_back(i < named ? std::string(GENERATOR_MANUFACTURERS[i])
+            : "Manufacturer " + std::to_string(i + 1));
+        weights.push_back(1.0 / std::pow(static_cast<double>(i + 1), config.manufacturerSkew));
+    }
+    manufacturerCumulative = cumulativeWeights(weights);
+    conditionCumulative = cumulativeWeights(std::vector<double>(
+        std::begin(config.conditionWeights), std::end(config.conditionWeights)));
+}
+
+uint64_t InventoryGenerator::nextRandom() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+double InventoryGenerator::nextUnit() {
+    return static_cast<double>(nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+size_t InventoryGenerator::pick(const std::vector<double>& cumulative) {
+    const double u = nextUnit();
+    auto it = std::upper_bound(cumulative.begin(), cumulative.end(), u);
+    return it == cumulative.end() ? cumulative.size() - 1 : static_cast<size_t>(it - cumulative.begin());
+}
+
+Car InventoryGenerator::next() {
+    const size_t maker = pick(manufacturerCumulative);
+    const uint64_t model = nextRandom() % config.modelsPerManufacturer;
+    const int year = config.minYear +
+        static_cast<int>(nextRandom() % static_cast<uint64_t>(config.maxYear - config.minYear + 1));
+    const double logMin = std::log(config.minPrice);
+    const double logMax = std::log(config.maxPrice);
+    const double price = std::round(std::exp(logMin + (logMax - logMin) * nextUnit()) * 100.0) / 100.0;
+    const auto type = static_cast<CarType>(nextRandom() % 5);
+    const auto condition = static_cast<Condition>(pick(conditionCumulative));
+    const char* scale = GENERATOR_SCALES[nextRandom() % (sizeof(GENERATOR_SCALES) / sizeof(GENERATOR_SCALES[0]))];
+    const char* color = GENERATOR_COLORS[nextRandom() % (sizeof(GENERATOR_COLORS) / sizeof(GENERATOR_COLORS[0]))];
+    const bool limited = nextUnit() < config.limitedEditionRate;
+
+    return Car(manufacturers[maker], "Model " + std::to_string(model + 1), year, price,
+        type, condition, scale, color, limited);
+}
+
+void InventoryGenerator::fill(Collection<Car>& collection, size_t count) {
+    collection.reserve(collection.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+        collection.emplaceItem(next());
+    }
+}
+
+bool InventoryGenerator::writeCSV(const GeneratorConfig& config, uint64_t count, const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Ошибка открытия файла: " << filename << std::endl;
+        return false;
+    }
+
+    InventoryGenerator generator(config);
+    FileHandler::writeCSVHeader(file);
+    for (uint64_t i = 0; i < count && file; ++i) {
+        FileHandler::writeCSVRow(file, generator.next());
+    }
+
+    file.close();
+    return file.good();
+}
+
+bool InventoryGenerator::writeBinary(const GeneratorConfig& config, uint64_t count, const std::string& filename) {
+    BlockBinaryWriter writer(filename, count);
+    if (!writer.isOpen()) {
+        return false;
+    }
+
+    InventoryGenerator generator(config);
+    for (uint64_t i = 0; i < count; ++i) {
+        writer.add(generator.next());
+    }
+    return writer.finish();
+}
+
+//  Histogram реализация 
+Histogram::Histogram(std::vector<double> edges) : edges(std::move(edges)) {
+    if (this->edges.size() < 2 || !std::is_sorted(this->edges.begin(), this->edges.end(), std::less_equal<double>())) {
+        throw std::invalid_argument("Границы гистограммы должны строго возрастать");
+    }
+    counts.assign(this->edges.size() - 1, 0);
+}
+
+Histogram Histogram::decimal(double from, double to) {
+    std::vector<double> edges;
+    for (double base = from; base <= to; base *= 10) {
+        for (double step : { 1.0, 2.0, 5.0 }) {
+            if (base * step <= to) {
+                edges.push_back(base * step);
+            }
+        }
+    }
+    return Histogram(std::move(edges));
+}
+
+void Histogram::add(double value) {
+    if (!(value >= edges.front())) {
+        ++below;
+    }
+    else if (value >= edges.back()) {
+        ++above;
+    }
+    else {
+        ++counts[std::upper_bound(edges.begin(), edges.end(), value) - edges.begin() - 1];
+    }
+}
+
+void Histogram::merge(const Histogram& other) {
+    if (edges != other.edges) {
+        throw std::invalid_argument("Гистограммы с разными границами не объединяются");
+    }
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    below += other.below;
+    above += other.above;
+}
+
+uint64_t Histogram::total() const {
+    uint64_t sum = below + above;
+    for (uint64_t count : counts) {
+        sum += count;
+    }
+    return sum;
+}
+
+namespace {
+    std::string formatNumber(double value) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(value == std::floor(value) ? 0 : 2) << value;
+        return out.str();
+    }
+}
+
+void Histogram::print(std::ostream& out, size_t width) const {
+    uint64_t largest = std::max(below, above);
+    for (uint64_t count : counts) {
+        largest = std::max(largest, count);
+    }
+    std::ostringstream text;
+    auto line = [&](const std::string& range, uint64_t count) {
+        const size_t bar = largest ? static_cast<size_t>(count * width / largest) : 0;
+        text << "  " << std::setw(21) << range << " | " << std::setw(9) << count << " "
+            << std::string(bar, '#') << "\n";
+    };
+    if (below) {
+        line("< " + formatNumber(edges.front()), below);
+    }
+    for (size_t i = 0; i < counts.size(); ++i) {
+        line(formatNumber(edges[i]) + " - " + formatNumber(edges[i + 1]), counts[i]);
+    }
+    if (above) {
+        line(">= " + formatNumber(edges.back()), above);
+    }
+    out << text.str();
+}
+
+//  QuantileSketch реализация 
+QuantileSketch::QuantileSketch(uint32_t k) : k(k) {
+    if (k < 8) {
+        throw std::invalid_argument("Параметр скетча k должен быть не меньше 8");
+    }
+    grow();
+}
+
+// Верхний уровень вмещает k значений, каждый следующий вниз - в 2/3 раза меньше
+size_t QuantileSketch::capacity(size_t level) const {
+    const size_t depth = levels.size() - 1 - level;
+    return std::max<size_t>(2, static_cast<size_t>(std::ceil(k * std::pow(2.0 / 3.0, depth))));
+}
+
+void QuantileSketch::grow() {
+    levels.emplace_back();
+    maxRetained = 0;
+    for (size_t level = 0; level < levels.size(); ++level) {
+        maxRetained += capacity(level);
+    }
+}
+
+// Сжимает нижний переполненный уровень: из каждой пары соседних (после сортировки)
+// значений на уровень выше переходит одно, вес которого вдвое больше
+void QuantileSketch::compress() {
+    for (size_t level = 0; level < levels.size(); ++level) {
+        if (levels[level].size() < capacity(level)) {
+            continue;
+        }
+        if (level + 1 == levels.size()) {
+            grow();
+        }
+        std::vector<double>& current = levels[level];
+        std::vector<double>& above = levels[level + 1];
+        std::sort(current.begin(), current.end());
+
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 7;
+        randomState ^= randomState << 17;
+        const size_t offset = randomState >> 63;
+        const size_t first = current.size() % 2;  // нечетное значение остается на уровне
+        for (size_t i = first; i + 1 < current.size(); i += 2) {
+            above.push_back(current[i + offset]);
+        }
+        retainedCount -= (current.size() - first) / 2;
+        current.resize(first);
+        return;
+    }
+}
+
+void QuantileSketch::add(double value) {
+    if (std::isnan(value)) {
+        return;
+    }
+    minValue = n == 0 ? value : std::min(minValue, value);
+    maxValue = n == 0 ? value : std::max(maxValue, value);
+    ++n;
+    levels[0].push_back(value);
+    if (++retainedCount >= maxRetained) {
+        compress();
+    }
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    if (other.k != k) {
+        throw std::invalid_argument("Скетчи с разным k не объединяются");
+    }
+    if (other.n == 0) {
+        return;
+    }
+    while (levels.size() < other.levels.size()) {
+        grow();
+    }
+    for (size_t level = 0; level < other.levels.size(); ++level) {
+        levels[level].insert(levels[level].end(), other.levels[level].begin(), other.levels[level].end());
+    }
+    minValue = n == 0 ? other.minValue : std::min(minValue, other.minValue);
+    maxValue = n == 0 ? other.maxValue : std::max(maxValue, other.maxValue);
+    n += other.n;
+    retainedCount += other.retainedCount;
+    while (retainedCount >= maxRetained) {
+        compress();
+    }
+}
+
+double QuantileSketch::quantile(double q) const {
+    if (n == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if (q <= 0.0) {
+        return minValue;
+    }
+    if (q >= 1.0) {
+        return maxValue;
+    }
+
+    std::vector<std::pair<double, uint64_t>> weighted;
+    weighted.reserve(retainedCount);
+    for (size_t level = 0; level < levels.size(); ++level) {
+        for (double value : levels[level]) {
+            weighted.emplace_back(value, uint64_t(1) << level);
+        }
+    }
+    std::sort(weighted.begin(), weighted.end());
+
+    const double target = q * static_cast<double>(n);
+    uint64_t seen = 0;
+    for (const auto& entry : weighted) {
+        seen += entry.second;
+        if (static_cast<double>(seen) >= target) {
+            return std::min(std::max(entry.first, minValue), maxValue);
+        }
+    }
+    return maxValue;
+}
+
+double QuantileSketch::rank(double value) const {
+    if (n == 0) {
+        return 0.0;
+    }
+    uint64_t below = 0;
+    for (size_t level = 0; level < levels.size(); ++level) {
+        for (double retainedValue : levels[level]) {
+            if (retainedValue <= value) {
+                below += uint64_t(1) << level;
+            }
+        }
+    }
+    return static_cast<double>(below) / static_cast<double>(n);
+}
+
+//  InventoryAnalytics реализация 
+InventoryAnalytics::InventoryAnalytics(uint32_t sketchK)
+    : sketchK(sketchK), priceBins(Histogram::decimal(1.0, 1000000.0)), prices(sketchK), values(sketchK) {
+}
+
+void InventoryAnalytics::add(const Car& car) {
+    const double price = car.getPrice();
+    const double value = car.calculateValue().toDouble();
+    priceBins.add(price);
+    prices.add(price);
+    values.add(value);
+    ++decades[car.getYear() / 10 * 10];
+    byManufacturer.try_emplace(car.getManufacturer(), sketchK).first->second.add(value);
+}
+
+void InventoryAnalytics::merge(const InventoryAnalytics& other) {
+    priceBins.merge(other.priceBins);
+    prices.merge(other.prices);
+    values.merge(other.values);
+    for (const auto& decade : other.decades) {
+        decades[decade.first] += decade.second;
+    }
+    for (const auto& manufacturer : other.byManufacturer) {
+        byManufacturer.try_emplace(manufacturer.first, sketchK).first->second.merge(manufacturer.second);
+    }
+}
+
+InventoryAnalytics InventoryAnalytics::of(const Collection<Car>& collection, unsigned threadCount) {
+    PROFILE_SCOPE("analytics.collection");
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(threadCount, collection.size()));
+    std::vector<InventoryAnalytics> partial(chunks);
+    std::vector<std::thread> workers;
+    // Элементы читаются по константной ссылке через итератор: operator[] проверяет
+    // границы и копирует shared_ptr, то есть два атомарных изменения счетчика на строку
+    auto summarize = [&collection, chunks, &partial](size_t chunk) {
+        const size_t from = collection.size() * chunk / chunks;
+        const size_t to = collection.size() * (chunk + 1) / chunks;
+        const auto rows = collection.begin();
+        for (size_t i = from; i < to; ++i) {
+            partial[chunk].add(*rows[i]);
+        }
+    };
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+        workers.emplace_back(summarize, chunk);
+    }
+    summarize(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+        partial[0].merge(partial[chunk]);
+    }
+    return std::move(partial[0]);
+}
+
+// Файл сводится отдельно и добавляется целиком: при ошибке чтения сводка не меняется
+bool InventoryAnalytics::addCSV(const std::string& filename, const LoadOptions& options) {
+    PROFILE_SCOPE("analytics.csv");
+    InventoryAnalytics file(sketchK);
+    if (!FileHandler::scanCSV(filename, [&file](std::shared_ptr<Car> car) { file.add(*car); }, options)) {
+        return false;
+    }
+    merge(file);
+    return true;
+}
+
+bool InventoryAnalytics::addBinary(const std::string& filename, const LoadOptions& options) {
+    PROFILE_SCOPE("analytics.binary");
+    InventoryAnalytics file(sketchK);
+    if (!FileHandler::scanBinary(filename, [&file](std::shared_ptr<Car> car) { file.add(*car); }, options)) {
+        return false;
+    }
+    merge(file);
+    return true;
+}
+
+void InventoryAnalytics::print(std::ostream& out) const {
+    std::ostringstream text;
+    text << "Машинок: " << count() << "\n";
+    if (count() == 0) {
+        out << text.str();
+        return;
+    }
+
+    text << "\nЦены, руб.:\n";
+    priceBins.print(text);
+
+    text << "\nПо десятилетиям выпуска:\n";
+    uint64_t largest = 0;
+    for (const auto& decade : decades) {
+        largest = std::max(largest, decade.second);
+    }
+    for (const auto& decade : decades) {
+        text << "  " << decade.first << "-е | " << std::setw(9) << decade.second << " "
+            << std::string(static_cast<size_t>(decade.second * 40 / largest), '#') << "\n";
+    }
+
+    // setw считает байты, а не символы UTF-8
+    auto pad = [](const std::string& str, size_t width) {
+        const size_t length = TextUtils::decodeUtf8(str).size();
+        return length < width ? std::string(width - length, ' ') : std::string();
+    };
+    const double levels[] = { 0.10, 0.25, 0.50, 0.75, 0.90, 0.99 };
+    text << "\nКвантили, руб." << pad("Квантили, руб.", 15) << pad("мин", 12) << "мин";
+    for (double q : levels) {
+        text << std::setw(12) << "p" + std::to_string(static_cast<int>(q * 100 + 0.5));
+    }
+    text << pad("макс", 12) << "макс" << "\n" << std::fixed << std::setprecision(2);
+    auto row = [&](const std::string& name, const QuantileSketch& sketch) {
+        text << "  " << name << pad(name, 13) << std::setw(12) << sketch.min();
+        for (double q : levels) {
+            text << std::setw(12) << sketch.quantile(q);
+        }
+        text << std::setw(12) << sketch.max() << "\n";
+    };
+    row("Цена", prices);
+    row("Оценка", values);
+
+    text << "\nОценка стоимости по производителям, руб. (медиана / p90):\n";
+    for (const auto& manufacturer : byManufacturer) {
+        const QuantileSketch& sketch = manufacturer.second;
+        text << "  " << manufacturer.first << " (" << sketch.count() << "): "
+            << sketch.quantile(0.5) << " / " << sketch.quantile(0.9) << "\n";
+    }
+    out << text.str();
+}
@@ -3,17 +3,209 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <optional>
 #include <memory>
 #include <vector>
+#include <deque>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
 #include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <future>
+#include <filesystem>
+
+
+//  Трассировка горячих участков
+//
+//  Включается при компиляции флагом -DCARS_TRACE; без него макросы TRACE_*
+//  раскрываются в пустые выражения и ничего не стоят. Результат - файл
+//  Chrome trace-event JSON (chrome://tracing, Perfetto) и сводная таблица.
+namespace Trace {
+    class Tracer {
+    public:
+        static Tracer& instance();
+
+        double nowUs() const;
+        void addEvent(const char* name, double startUs, double durationUs);
+        void addCounter(const char* name, int64_t value);
+        // Итог накопителя: одна запись вместо события на каждую итерацию цикла
+        void addSummary(const char* name, uint64_t calls, double totalUs, double maxUs);
+
+        bool writeChromeTrace(const std::string& filename) const;
+        void printSummary(std::ostream& out) const;
+        bool empty() const;
+        void reset();
+
+    private:
+        Tracer();
+
+        struct Event {
+            const char* name;
+            char phase;        // 'X' - интервал, 'C' - счетчик
+            double ts;
+            double dur;
+            int64_t value;
+            uint32_t tid;
+        };
+
+        struct Stat {
+            uint64_t calls = 0;
+            double totalUs = 0.0;
+            double maxUs = 0.0;
+        };
+
+        uint32_t threadIndex();
+
+        mutable std::mutex mutex;
+        std::chrono::steady_clock::time_point origin;
+        std::vector<Event> events;
+        std::map<std::string, Stat> stats;
+        std::map<std::thread::id, uint32_t> threads;
+    };
+
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(const char* name) : name(name), start(Tracer::instance().nowUs()) {}
+        ~ScopedTimer() {
+            Tracer& tracer = Tracer::instance();
+            tracer.addEvent(name, start, tracer.nowUs() - start);
+        }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        const char* name;
+        double start;
+    };
+
+    // Суммирует время участка внутри цикла без блокировок и событий на каждую итерацию
+    class Accumulator {
+    public:
+        explicit Accumulator(const char* name) : name(name) {}
+        ~Accumulator() {
+            if (calls) {
+                Tracer::instance().addSummary(name, calls, totalUs, maxUs);
+            }
+        }
+        Accumulator(const Accumulator&) = delete;
+        Accumulator& operator=(const Accumulator&) = delete;
+
+        void add(double us) {
+            ++calls;
+            totalUs += us;
+            maxUs = std::max(maxUs, us);
+        }
+
+        class Scope {
+        public:
+            explicit Scope(Accumulator& acc) : acc(acc), start(Tracer::instance().nowUs()) {}
+            ~Scope() { acc.add(Tracer::instance().nowUs() - start); }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Accumulator& acc;
+            double start;
+        };
+
+    private:
+        const char* name;
+        uint64_t calls = 0;
+        double totalUs = 0.0;
+        double maxUs = 0.0;
+    };
+
+#ifdef CARS_TRACE
+    constexpr bool ENABLED = true;
+#else
+    constexpr bool ENABLED = false;
+#endif
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef CARS_TRACE
+#define TRACE_SCOPE(name) ::Trace::ScopedTimer TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) ::Trace::Tracer::instance().addCounter(name, static_cast<int64_t>(value))
+#define TRACE_ACCUMULATOR(var, name) ::Trace::Accumulator var(name)
+#define TRACE_ACCUMULATE(var) ::Trace::Accumulator::Scope TRACE_CONCAT(traceAcc_, __LINE__)(var)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#define TRACE_ACCUMULATOR(var, name) ((void)0)
+#define TRACE_ACCUMULATE(var) ((void)0)
+#endif
+
+//  Учет выделений памяти
+//
+//  Включается флагом -DCARS_ALLOC_TRACKING: глобальный operator new считает
+//  число выделений и байты, а ALLOC_SCOPE(имя) относит прирост счетчиков
+//  за время своей жизни к операции. Счетчики общие для всех потоков, поэтому
+//  выделения рабочих потоков параллельной загрузки учитываются в ней же.
+namespace AllocProfile {
+#ifdef CARS_ALLOC_TRACKING
+    constexpr bool ENABLED = true;
+#else
+    constexpr bool ENABLED = false;
+#endif
+
+    struct Stat {
+        uint64_t calls = 0;
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+    };
+
+    // Всего выделений и байт с начала работы (0, если учет не включен)
+    uint64_t allocationCount();
+    uint64_t allocatedBytes();
+
+    std::map<std::string, Stat> snapshot();
+    void printReport(std::ostream& out);
+    void reset();
+
+    class Scope {
+    public:
+        explicit Scope(const char* name)
+            : name(name), startCount(allocationCount()), startBytes(allocatedBytes()) {}
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        uint64_t startCount;
+        uint64_t startBytes;
+    };
+}
+
+#ifdef CARS_ALLOC_TRACKING
+#define ALLOC_SCOPE(name) ::AllocProfile::Scope TRACE_CONCAT(allocScope_, __LINE__)(name)
+#else
+#define ALLOC_SCOPE(name) ((void)0)
+#endif
 
+// Операция целиком: интервал в трассе и учет выделений памяти
+#define PROFILE_SCOPE(name) TRACE_SCOPE(name); ALLOC_SCOPE(name)
 
 enum class CarType {
     SCALE_MODEL,
@@ -32,73 +224,237 @@ enum class Condition {
 };
 
 namespace EnumUtils {
+    // Таблицы индексируются значением перечисления; строки живут в статической памяти
+    constexpr std::string_view CAR_TYPE_NAMES[] = {
+        "Масштабная модель",
+        "Литой металл",
+        "Радиоуправляемая",
+        "Электрическая модель",
+        "Кастомная сборка"
+    };
+
+    constexpr std::string_view CONDITION_NAMES[] = {
+        "Идеальное",
+        "Отличное",
+        "Хорошее",
+        "Удовлетворительное",
+        "Плохое"
+    };
+
+    constexpr std::string_view CAR_TYPE_NAMES_EN[] = {
+        "Scale Model",
+        "Die Cast",
+        "Radio Controlled",
+        "Electric Model",
+        "Custom Build"
+    };
+
+    constexpr std::string_view CONDITION_NAMES_EN[] = {
+        "Mint",
+        "Excellent",
+        "Good",
+        "Fair",
+        "Poor"
+    };
+
+    template<size_t N>
+    constexpr std::string_view lookup(const std::string_view (&table)[N], size_t index,
+        std::string_view unknown) {
+        return index < N ? table[index] : unknown;
+    }
+
     // Функции для консоли (русский язык)
-    inline std::string carTypeToStr(CarType type) {
-        static const std::map<CarType, std::string> carTypeToString = {
-            {CarType::SCALE_MODEL, "Масштабная модель"},
-            {CarType::DIE_CAST, "Литой металл"},
-            {CarType::RADIO_CONTROLLED, "Радиоуправляемая"},
-            {CarType::ELECTRIC_MODEL, "Электрическая модель"},
-            {CarType::CUSTOM_BUILD, "Кастомная сборка"}
-        };
-        auto it = carTypeToString.find(type);
-        return it != carTypeToString.end() ? it->second : "Неизвестно";
+    constexpr std::string_view carTypeToStr(CarType type) {
+        return lookup(CAR_TYPE_NAMES, static_cast<size_t>(type), "Неизвестно");
     }
 
-    inline std::string conditionToStr(Condition cond) {
-        static const std::map<Condition, std::string> conditionToString = {
-            {Condition::MINT, "Идеальное"},
-            {Condition::EXCELLENT, "Отличное"},
-            {Condition::GOOD, "Хорошее"},
-            {Condition::FAIR, "Удовлетворительное"},
-            {Condition::POOR, "Плохое"}
-        };
-        auto it = conditionToString.find(cond);
-        return it != conditionToString.end() ? it->second : "Неизвестно";
+    constexpr std::string_view conditionToStr(Condition cond) {
+        return lookup(CONDITION_NAMES, static_cast<size_t>(cond), "Неизвестно");
     }
 
     // Функции для CSV (английский язык)
-    inline std::string carTypeToStrEN(CarType type) {
-        static const std::map<CarType, std::string> carTypeToStringEN = {
-            {CarType::SCALE_MODEL, "Scale Model"},
-            {CarType::DIE_CAST, "Die Cast"},
-            {CarType::RADIO_CONTROLLED, "Radio Controlled"},
-            {CarType::ELECTRIC_MODEL, "Electric Model"},
-            {CarType::CUSTOM_BUILD, "Custom Build"}
-        };
-        auto it = carTypeToStringEN.find(type);
-        return it != carTypeToStringEN.end() ? it->second : "Unknown";
+    constexpr std::string_view carTypeToStrEN(CarType type) {
+        return lookup(CAR_TYPE_NAMES_EN, static_cast<size_t>(type), "Unknown");
     }
 
-    inline std::string conditionToStrEN(Condition cond) {
-        static const std::map<Condition, std::string> conditionToStringEN = {
-            {Condition::MINT, "Mint"},
-            {Condition::EXCELLENT, "Excellent"},
-            {Condition::GOOD, "Good"},
-            {Condition::FAIR, "Fair"},
-            {Condition::POOR, "Poor"}
-        };
-        auto it = conditionToStringEN.find(cond);
-        return it != conditionToStringEN.end() ? it->second : "Unknown";
+    constexpr std::string_view conditionToStrEN(Condition cond) {
+        return lookup(CONDITION_NAMES_EN, static_cast<size_t>(cond), "Unknown");
+    }
+
+    // Разбор английских названий: длины названий типов различны,
+    // поэтому достаточно выбора по длине и одного сравнения
+    constexpr std::optional<CarType> parseCarType(std::string_view str) {
+        CarType candidate = CarType::SCALE_MODEL;
+        switch (str.size()) {
+        case 11: candidate = CarType::SCALE_MODEL; break;
+        case 8: candidate = CarType::DIE_CAST; break;
+        case 16: candidate = CarType::RADIO_CONTROLLED; break;
+        case 14: candidate = CarType::ELECTRIC_MODEL; break;
+        case 12: candidate = CarType::CUSTOM_BUILD; break;
+        default: return std::nullopt;
+        }
+        if (str == carTypeToStrEN(candidate)) {
+            return candidate;
+        }
+        return std::nullopt;
+    }
+
+    // Все состояния, кроме "Excellent", длиной 4 - различаем по первой букве
+    constexpr std::optional<Condition> parseCondition(std::string_view str) {
+        Condition candidate = Condition::GOOD;
+        if (str.size() == 9) {
+            candidate = Condition::EXCELLENT;
+        }
+        else if (str.size() == 4) {
+            switch (str[0]) {
+            case 'M': candidate = Condition::MINT; break;
+            case 'G': candidate = Condition::GOOD; break;
+            case 'F': candidate = Condition::FAIR; break;
+            case 'P': candidate = Condition::POOR; break;
+            default: return std::nullopt;
+            }
+        }
+        else {
+            return std::nullopt;
+        }
+        if (str == conditionToStrEN(candidate)) {
+            return candidate;
+        }
+        return std::nullopt;
     }
 
-    inline CarType stringToCarType(const std::string& str) {
-        if (str == "Scale Model") return CarType::SCALE_MODEL;
-        if (str == "Die Cast") return CarType::DIE_CAST;
-        if (str == "Radio Controlled") return CarType::RADIO_CONTROLLED;
-        if (str == "Electric Model") return CarType::ELECTRIC_MODEL;
-        if (str == "Custom Build") return CarType::CUSTOM_BUILD;
-        return CarType::SCALE_MODEL;
+    // Неизвестные значения - ошибка, а не молчаливое значение по умолчанию
+    inline CarType stringToCarType(std::string_view str) {
+        if (auto type = parseCarType(str)) {
+            return *type;
+        }
+        throw std::invalid_argument("Неизвестный тип машинки: " + std::string(str));
+    }
+
+    inline Condition stringToCondition(std::string_view str) {
+        if (auto condition = parseCondition(str)) {
+            return *condition;
+        }
+        throw std::invalid_argument("Неизвестное состояние: " + std::string(str));
+    }
+}
+
+// Быстрое 64-битное хеширование в духе wyhash: умножение 64x64->128
+// со сверткой старшей и младшей половин
+namespace HashUtils {
+    constexpr uint64_t P0 = 0xa0761d6478bd642fULL;
+    constexpr uint64_t P1 = 0xe7037ed1a0b428dbULL;
+    constexpr uint64_t P2 = 0x8ebc6af09c88c6e3ULL;
+    constexpr uint64_t P3 = 0x589965cc75374cc3ULL;
+
+    inline uint64_t mum(uint64_t a, uint64_t b) {
+        const uint64_t ha = a >> 32, la = static_cast<uint32_t>(a);
+        const uint64_t hb = b >> 32, lb = static_cast<uint32_t>(b);
+        const uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+        const uint64_t t = ll + (hl << 32);
+        uint64_t carry = t < ll;
+        const uint64_t lo = t + (lh << 32);
+        carry += lo < t;
+        const uint64_t hi = hh + (hl >> 32) + (lh >> 32) + carry;
+        return lo ^ hi;
+    }
+
+    inline uint64_t read64(const unsigned char* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t read32(const unsigned char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t hashBytes(const void* data, size_t length, uint64_t seed = 0) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        seed ^= P0;
+        size_t rest = length;
+        while (rest > 16) {
+            seed = mum(read64(p) ^ P1, read64(p + 8) ^ seed);
+            p += 16;
+            rest -= 16;
+        }
+
+        uint64_t a = 0, b = 0;
+        if (rest >= 8) {
+            a = read64(p);
+            b = read64(p + rest - 8);
+        }
+        else if (rest >= 4) {
+            a = read32(p);
+            b = read32(p + rest - 4);
+        }
+        else if (rest > 0) {
+            a = (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[rest >> 1]) << 8) | p[rest - 1];
+        }
+        return mum(P1 ^ length, mum(a ^ P1, b ^ seed));
+    }
+
+    inline uint64_t hashString(const std::string& str, uint64_t seed = 0) {
+        return hashBytes(str.data(), str.size(), seed);
     }
 
-    inline Condition stringToCondition(const std::string& str) {
-        if (str == "Mint") return Condition::MINT;
-        if (str == "Excellent") return Condition::EXCELLENT;
-        if (str == "Good") return Condition::GOOD;
-        if (str == "Fair") return Condition::FAIR;
-        if (str == "Poor") return Condition::POOR;
-        return Condition::GOOD;
+    inline uint64_t combine(uint64_t seed, uint64_t value) {
+        return mum(seed ^ P2, value ^ P3);
     }
+
+    // Хеш идентичности машинки (см. CarKey): производитель, модель, год, масштаб, цвет
+    inline uint64_t hashIdentity(const std::string& manufacturer, const std::string& model,
+        int year, const std::string& scale, const std::string& color) {
+        uint64_t h = hashString(manufacturer);
+        h = hashString(model, h);
+        h = combine(h, static_cast<uint64_t>(static_cast<uint32_t>(year)));
+        h = hashString(scale, h);
+        return hashString(color, h);
+    }
+}
+
+// Денежная сумма с фиксированной точкой: целое число копеек.
+// Сложение целых точное и ассоциативное, поэтому итоги не накапливают ошибку
+// и не зависят от порядка суммирования и числа потоков
+class Money {
+public:
+    constexpr Money() = default;
+    static constexpr Money fromKopecks(int64_t kopecks) { return Money(kopecks); }
+    // Округление до ближайшей копейки; бросает std::invalid_argument для NaN и переполнения
+    static Money fromDouble(double rubles);
+    // Точный разбор десятичной записи: "12", "-3.5", "1234.56"; больше двух знаков
+    // после точки или лишние символы - std::nullopt
+    static std::optional<Money> parse(std::string_view text);
+
+    constexpr int64_t kopecks() const { return value; }
+    double toDouble() const { return static_cast<double>(value) / 100.0; }
+    // Ровно два знака после точки, без промежуточного double
+    std::string toString() const;
+
+    // Умножение на дробь numerator / denominator с одним округлением (половина - от нуля)
+    Money scaled(int64_t numerator, int64_t denominator) const;
+
+    constexpr Money operator+(Money other) const { return Money(value + other.value); }
+    constexpr Money operator-(Money other) const { return Money(value - other.value); }
+    Money& operator+=(Money other) { value += other.value; return *this; }
+    Money& operator-=(Money other) { value -= other.value; return *this; }
+
+    constexpr bool operator==(Money other) const { return value == other.value; }
+    constexpr bool operator!=(Money other) const { return value != other.value; }
+    constexpr bool operator<(Money other) const { return value < other.value; }
+    constexpr bool operator>(Money other) const { return value > other.value; }
+    constexpr bool operator<=(Money other) const { return value <= other.value; }
+    constexpr bool operator>=(Money other) const { return value >= other.value; }
+
+private:
+    constexpr explicit Money(int64_t kopecks) : value(kopecks) {}
+    int64_t value = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& os, Money money) {
+    return os << money.toString();
 }
 
 // Базовый класс Vehicle 
@@ -107,11 +463,14 @@ protected:
     std::string manufacturer;
     std::string model;
     int year;
-    double price;
+    Money price;
 
 public:
     Vehicle();
-    Vehicle(const std::string& manufacturer, const std::string& model,
+    // Строки принимаются по значению и перемещаются в поля
+    Vehicle(std::string manufacturer, std::string model,
+        int year, Money price);
+    Vehicle(std::string manufacturer, std::string model,
         int year, double price);
     Vehicle(const Vehicle& other);
     Vehicle(Vehicle&& other) noexcept;
@@ -128,15 +487,19 @@ public:
     std::string getManufacturer() const { return manufacturer; }
     std::string getModel() const { return model; }
     int getYear() const { return year; }
-    double getPrice() const { return price; }
+    double getPrice() const { return price.toDouble(); }
+    Money getPriceMoney() const { return price; }
 
-    void setManufacturer(const std::string& manufacturer) { this->manufacturer = manufacturer; }
-    void setModel(const std::string& model) { this->model = model; }
-    void setYear(int year) { this->year = year; }
-    void setPrice(double price) { this->price = price; }
+    void setManufacturer(const std::string& manufacturer) { this->manufacturer = manufacturer; invalidateRender(); }
+    void setModel(const std::string& model) { this->model = model; invalidateRender(); }
+    void setYear(int year) { this->year = year; invalidateRender(); }
+    void setPrice(double price) { this->price = Money::fromDouble(price); invalidateRender(); }
+    void setPrice(Money price) { this->price = price; invalidateRender(); }
 
     virtual void displayInfo() const = 0;
     virtual std::string toString() const = 0;
+    // toString(), сохраненный до следующего изменения полей (не потокобезопасно)
+    const std::string& renderedString() const;
     virtual std::unique_ptr<Vehicle> clone() const = 0;
 
     virtual void updateInfo(const std::string& manufacturer, const std::string& model,
@@ -147,9 +510,11 @@ public:
 
 protected:
     virtual void print(std::ostream& os) const;
+    void invalidateRender() { renderCache.clear(); }
 
 private:
-    static int vehicleCount;
+    static std::atomic<int> vehicleCount;  // машинки создаются и в потоках загрузки
+    mutable std::string renderCache;  // пусто - кэш недействителен
 };
 
 //  Класс Car 
@@ -163,9 +528,12 @@ private:
 
 public:
     Car();
-    Car(const std::string& manufacturer, const std::string& model,
+    Car(std::string manufacturer, std::string model,
+        int year, Money price, CarType type, Condition condition,
+        std::string scale, std::string color, bool limitedEdition);
+    Car(std::string manufacturer, std::string model,
         int year, double price, CarType type, Condition condition,
-        const std::string& scale, const std::string& color, bool limitedEdition);
+        std::string scale, std::string color, bool limitedEdition);
     Car(const Car& other);
     Car(Car&& other) noexcept;
     ~Car() override = default;
@@ -173,6 +541,10 @@ public:
     Car& operator=(const Car& other);
     Car& operator=(Car&& other) noexcept;
 
+    // Полное сравнение всех полей (Vehicle::operator== не учитывает поля Car)
+    bool operator==(const Car& other) const;
+    bool operator!=(const Car& other) const;
+
     friend inline std::ostream& operator<<(std::ostream& os, const Car& car);
 
     CarType getType() const { return type; }
@@ -181,11 +553,11 @@ public:
     std::string getColor() const { return color; }
     bool isLimitedEdition() const { return limitedEdition; }
 
-    void setType(CarType type) { this->type = type; }
-    void setCondition(Condition condition) { this->condition = condition; }
-    void setScale(const std::string& scale) { this->scale = scale; }
-    void setColor(const std::string& color) { this->color = color; }
-    void setLimitedEdition(bool limited) { limitedEdition = limited; }
+    void setType(CarType type) { this->type = type; invalidateRender(); }
+    void setCondition(Condition condition) { this->condition = condition; invalidateRender(); }
+    void setScale(const std::string& scale) { this->scale = scale; invalidateRender(); }
+    void setColor(const std::string& color) { this->color = color; invalidateRender(); }
+    void setLimitedEdition(bool limited) { limitedEdition = limited; invalidateRender(); }
 
     void displayInfo() const override;
     std::string toString() const override;
@@ -196,32 +568,444 @@ public:
         int year, double price, CarType type, Condition condition,
         const std::string& scale, const std::string& color, bool limitedEdition);
 
-    double calculateValue() const;
+    // Оценка: цена с надбавками за состояние и серию, округленная один раз
+    Money calculateValue() const;
     bool isValuable() const;
+    uint64_t identityHash() const;
 
-    static constexpr double RARE_MULTIPLIER = 1.5;
-    static constexpr double MINT_CONDITION_BONUS = 1.3;
+    // Множители оценки в процентах
+    static constexpr int64_t RARE_MULTIPLIER_PERCENT = 150;
+    static constexpr int64_t MINT_CONDITION_BONUS_PERCENT = 130;
 
 private:
     void print(std::ostream& os) const override;
 };
 
+// Хеш по полям идентичности согласован с Car::operator==:
+// равные машинки совпадают и по этим полям
+namespace std {
+    template<>
+    struct hash<Car> {
+        size_t operator()(const Car& car) const noexcept {
+            return static_cast<size_t>(car.identityHash());
+        }
+    };
+}
+
+// Как removeItem заполняет место удаленной строки
+enum class RemovalMode {
+    PRESERVE_ORDER,  // сдвиг следующих строк, O(N)
+    SWAP_AND_POP     // на место удаленной встает последняя строка, O(1)
+};
+
+// Вид изменения коллекции
+enum class ChangeKind {
+    INSERT,   // элемент добавлен в строку row
+    REMOVE,   // элемент удален из строки row (номер до удаления)
+    UPDATE,   // элемент в строке row заменен (editItem)
+    MOVE,     // элемент перенесен в строку row при удалении перестановкой
+    REORDER,  // коллекция пересортирована, ссылка и row не заполнены
+    CLEAR     // коллекция очищена, ссылка и row не заполнены
+};
+
+// Рассылка пакетов событий подписчикам. Пока подписчиков нет, события
+// не создаются. Подписки принадлежат объекту и не копируются вместе с ним.
+// Пакет может рассылаться из деструктора ChangeBatch, поэтому исключение
+// подписчика не выходит из рассылки: оно выводится в cerr, а пакет
+// получают остальные подписчики
+template<typename Event>
+class ChangeFeed {
+public:
+    using Listener = std::function<void(const std::vector<Event>&)>;
+
+    ChangeFeed() = default;
+    ChangeFeed(const ChangeFeed&) {}
+    ChangeFeed& operator=(const ChangeFeed&) { return *this; }
+
+    bool active() const { return !listeners.empty(); }
+
+    size_t subscribe(Listener listener) {
+        listeners.emplace_back(++lastId, std::move(listener));
+        return lastId;
+    }
+
+    bool unsubscribe(size_t id) {
+        auto it = std::find_if(listeners.begin(), listeners.end(),
+            [id](const auto& entry) { return entry.first == id; });
+        if (it == listeners.end()) {
+            return false;
+        }
+        listeners.erase(it);
+        return true;
+    }
+
+    void push(Event event) {
+        pending.push_back(std::move(event));
+        if (depth == 0) {
+            flush();
+        }
+    }
+
+    // События между begin и end доставляются одним пакетом
+    void begin() { ++depth; }
+    void end() {
+        if (depth > 0 && --depth == 0) {
+            flush();
+        }
+    }
+
+private:
+    void flush() {
+        if (pending.empty()) {
+            return;
+        }
+        std::vector<Event> batch;
+        batch.swap(pending);
+        // Копия списка: подписчик может отписаться прямо из обработчика
+        const auto current = listeners;
+        for (const auto& entry : current) {
+            try {
+                entry.second(batch);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Ошибка подписчика на изменения: " << e.what() << std::endl;
+            }
+            catch (...) {
+                std::cerr << "Неизвестная ошибка подписчика на изменения" << std::endl;
+            }
+        }
+    }
+
+    std::vector<std::pair<size_t, Listener>> listeners;
+    std::vector<Event> pending;
+    size_t lastId = 0;
+    unsigned depth = 0;
+};
+
+// Вектор из блоков по CHUNK_SIZE элементов с подсчетом ссылок на блоки.
+// Копия разделяет таблицу блоков с оригиналом и создается за O(1); запись
+// копирует таблицу (O(N / CHUNK_SIZE)) и только затронутый блок, остальные
+// блоки остаются общими. Копию можно читать из другого потока, пока
+// оригинал изменяется: общие блоки никогда не меняются на месте.
+template<typename V>
+class ChunkedVector {
+public:
+    static constexpr size_t CHUNK_BITS = 10;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = V;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const V*;
+        using reference = const V&;
+
+        const_iterator() = default;
+        const_iterator(const ChunkedVector* owner, size_t index) : owner(owner), index(index) {}
+
+        reference operator*() const { return (*owner)[index]; }
+        pointer operator->() const { return &(*owner)[index]; }
+        reference operator[](difference_type n) const { return (*owner)[index + n]; }
+
+        const_iterator& operator++() { ++index; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; ++index; return old; }
+        const_iterator& operator--() { --index; return *this; }
+        const_iterator operator--(int) { const_iterator old = *this; --index; return old; }
+        const_iterator& operator+=(difference_type n) { index += n; return *this; }
+        const_iterator& operator-=(difference_type n) { index -= n; return *this; }
+        const_iterator operator+(difference_type n) const { return const_iterator(owner, index + n); }
+        const_iterator operator-(difference_type n) const { return const_iterator(owner, index - n); }
+        friend const_iterator operator+(difference_type n, const const_iterator& it) { return it + n; }
+        difference_type operator-(const const_iterator& other) const {
+            return static_cast<difference_type>(index) - static_cast<difference_type>(other.index);
+        }
+
+        bool operator==(const const_iterator& other) const { return index == other.index; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+        bool operator<(const const_iterator& other) const { return index < other.index; }
+        bool operator>(const const_iterator& other) const { return index > other.index; }
+        bool operator<=(const const_iterator& other) const { return index <= other.index; }
+        bool operator>=(const const_iterator& other) const { return index >= other.index; }
+
+    private:
+        const ChunkedVector* owner = nullptr;
+        size_t index = 0;
+    };
+
+    ChunkedVector() : chunks(std::make_shared<ChunkList>()) {}
+    // Перемещение тоже разделяет блоки: исходный объект остается действительным
+    ChunkedVector(const ChunkedVector&) = default;
+    ChunkedVector& operator=(const ChunkedVector&) = default;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const V& operator[](size_t index) const {
+        return (*(*chunks)[index >> CHUNK_BITS])[index & (CHUNK_SIZE - 1)];
+    }
+
+    // Ссылка для записи: общий блок предварительно копируется
+    V& mutableAt(size_t index) {
+        return ownChunk(index >> CHUNK_BITS)[index & (CHUNK_SIZE - 1)];
+    }
+
+    void push_back(V value) {
+        if ((count & (CHUNK_SIZE - 1)) == 0) {
+            auto chunk = std::make_shared<Chunk>();
+            chunk->reserve(CHUNK_SIZE);
+            ownList().push_back(std::move(chunk));
+        }
+        ownChunk(count >> CHUNK_BITS).push_back(std::move(value));
+        ++count;
+    }
+
+    void pop_back() {
+        ownChunk((count - 1) >> CHUNK_BITS).pop_back();
+        --count;
+        if ((count & (CHUNK_SIZE - 1)) == 0) {
+            ownList().pop_back();
+        }
+    }
+
+    // Сдвиг следующих элементов по блокам: копируются только блоки от index до конца
+    void erase(size_t index) {
+        size_t chunk = index >> CHUNK_BITS;
+        const size_t lastChunk = (count - 1) >> CHUNK_BITS;
+        Chunk* current = &ownChunk(chunk);
+        current->erase(current->begin() + (index & (CHUNK_SIZE - 1)));
+        for (; chunk < lastChunk; ++chunk) {
+            Chunk& next = ownChunk(chunk + 1);
+            current->push_back(std::move(next.front()));
+            next.erase(next.begin());
+            current = &next;
+        }
+        --count;
+        if ((count & (CHUNK_SIZE - 1)) == 0) {
+            ownList().pop_back();
+        }
+    }
+
+    void clear() {
+        chunks = std::make_shared<ChunkList>();
+        count = 0;
+    }
+
+    // Забирает все элементы (из необщих блоков - перемещением) и очищает вектор
+    std::vector<V> takeAll() {
+        std::vector<V> values;
+        values.reserve(count);
+        const bool ownsList = chunks.use_count() == 1;
+        for (auto& chunk : *chunks) {
+            if (ownsList && chunk.use_count() == 1) {
+                std::move(chunk->begin(), chunk->end(), std::back_inserter(values));
+            }
+            else {
+                values.insert(values.end(), chunk->begin(), chunk->end());
+            }
+        }
+        clear();
+        return values;
+    }
+
+    // Заменяет содержимое элементами values, собирая новые блоки
+    void assign(std::vector<V>&& values) {
+        auto list = std::make_shared<ChunkList>();
+        list->reserve((values.size() + CHUNK_SIZE - 1) >> CHUNK_BITS);
+        for (size_t from = 0; from < values.size(); from += CHUNK_SIZE) {
+            const size_t to = std::min(from + CHUNK_SIZE, values.size());
+            auto chunk = std::make_shared<Chunk>();
+            chunk->reserve(CHUNK_SIZE);
+            chunk->insert(chunk->end(), std::make_move_iterator(values.begin() + from),
+                std::make_move_iterator(values.begin() + to));
+            list->push_back(std::move(chunk));
+        }
+        chunks = std::move(list);
+        count = values.size();
+        values.clear();
+    }
+
+    void reserve(size_t capacity) {
+        ownList().reserve((capacity + CHUNK_SIZE - 1) >> CHUNK_BITS);
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+private:
+    using Chunk = std::vector<V>;
+    using ChunkList = std::vector<std::shared_ptr<Chunk>>;
+
+    ChunkList& ownList() {
+        if (chunks.use_count() > 1) {
+            chunks = std::make_shared<ChunkList>(*chunks);
+        }
+        return *chunks;
+    }
+
+    Chunk& ownChunk(size_t chunk) {
+        ChunkList& list = ownList();
+        if (list[chunk].use_count() > 1) {
+            auto copy = std::make_shared<Chunk>();
+            copy->reserve(CHUNK_SIZE);
+            copy->assign(list[chunk]->begin(), list[chunk]->end());
+            list[chunk] = std::move(copy);
+        }
+        return *list[chunk];
+    }
+
+    std::shared_ptr<ChunkList> chunks;
+    size_t count = 0;
+};
+
+// Неизменяемый снимок коллекции (см. Collection::snapshot). Создается за O(1)
+// и не меняется при последующем редактировании коллекции, поэтому экспорт
+// можно выполнять из снимка в другом потоке. Машинки в снимке общие
+// с коллекцией: менять их поля через указатель во время чтения нельзя
+// (editItem заменяет указатель и на снимок не влияет).
+template<typename T>
+class CollectionSnapshot {
+public:
+    CollectionSnapshot(ChunkedVector<std::shared_ptr<T>> items, std::string name, uint64_t version)
+        : items(std::move(items)), name(std::move(name)), version(version) {}
+
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+    const std::shared_ptr<T>& operator[](size_t index) const { return items[index]; }
+    auto begin() const { return items.begin(); }
+    auto end() const { return items.end(); }
+    const std::string& getName() const { return name; }
+    uint64_t getVersion() const { return version; }
+
+private:
+    ChunkedVector<std::shared_ptr<T>> items;
+    std::string name;
+    uint64_t version;
+};
+
 // Шаблонный класс Collection 
 template<typename T>
 class Collection {
+public:
+    // Устойчивая ссылка на элемент (слот + поколение): не меняется при сортировке
+    // и удалении других элементов, после удаления самого элемента недействительна
+    struct Handle {
+        uint32_t slot = UINT32_MAX;
+        uint32_t generation = 0;
+
+        bool operator==(const Handle& other) const {
+            return slot == other.slot && generation == other.generation;
+        }
+        bool operator!=(const Handle& other) const { return !(*this == other); }
+    };
+
+    // Событие изменения: устойчивая ссылка на элемент и номер строки
+    struct Change {
+        ChangeKind kind;
+        Handle handle;
+        size_t row;
+    };
+    using ChangeListener = std::function<void(const std::vector<Change>&)>;
+
+    // Объединяет события всех изменений в своей области видимости в один пакет
+    class ChangeBatch {
+    public:
+        explicit ChangeBatch(Collection& collection) : collection(collection) { collection.changes.begin(); }
+        ~ChangeBatch() { collection.changes.end(); }
+        ChangeBatch(const ChangeBatch&) = delete;
+        ChangeBatch& operator=(const ChangeBatch&) = delete;
+
+    private:
+        Collection& collection;
+    };
+
+    // Пакет вставок, замен и удалений, который применяется целиком или не применяется.
+    // До commit коллекция не меняется; rollback и деструктор без commit просто
+    // отбрасывают накопленное - O(числа изменений)
+    class Transaction {
+    public:
+        explicit Transaction(Collection& collection) : collection(collection) {}
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+        void insert(std::shared_ptr<T> item);
+        // false, если ссылка уже недействительна или элемент пустой
+        bool update(Handle handle, std::shared_ptr<T> item);
+        bool remove(Handle handle);
+
+        // Применяет все изменения за один проход: одна версия, один пакет событий
+        // (строки UPDATE и REMOVE - до удаления, INSERT - итоговые). Замена удаляемого
+        // элемента игнорируется, из нескольких замен действует последняя. Если за время
+        // транзакции какая-то ссылка стала недействительной, ничего не применяется
+        // и возвращается false; накопленное остается для повтора или rollback
+        bool commit();
+        void rollback();
+
+        size_t size() const { return inserts.size() + updates.size() + removals.size(); }
+        bool empty() const { return size() == 0; }
+
+    private:
+        Collection& collection;
+        std::vector<std::shared_ptr<T>> inserts;
+        std::vector<std::pair<Handle, std::shared_ptr<T>>> updates;
+        std::vector<Handle> removals;
+    };
+
 private:
-    std::vector<std::shared_ptr<T>> items;
+    ChunkedVector<std::shared_ptr<T>> items;  // блоки общие со снимками
     std::string name;
+    uint64_t version = 0;  // растет при каждом изменении состава или порядка
+
+    // Таблица слотов: строка <-> слот, поколение слота и свободные слоты
+    std::vector<uint32_t> slotOfRow;
+    std::vector<uint32_t> rowOfSlot;
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> freeSlots;
+    RemovalMode removalMode = RemovalMode::PRESERVE_ORDER;
+    ChangeFeed<Change> changes;
 
 public:
     Collection() = default;
     explicit Collection(const std::string& name) : name(name) {}
+    Collection(const Collection&) = default;
+    Collection(Collection&&) = default;
     ~Collection() = default;
-
-    void addItem(std::shared_ptr<T> item);
+    // Присваивание заменяет все содержимое, подписки остаются у этой коллекции:
+    // подписчики получают одним пакетом CLEAR и INSERT для каждой новой строки
+    Collection& operator=(const Collection& other);
+    Collection& operator=(Collection&& other);
+
+    Handle addItem(std::shared_ptr<T> item);
+    // Пакетное добавление: память резервируется один раз, версия растет один раз;
+    // при пустом указателе в пакете коллекция не изменяется
+    template<typename ForwardIt>
+    void addItems(ForwardIt first, ForwardIt last);
+    void addItems(std::vector<std::shared_ptr<T>>&& batch);
+    // Создает элемент прямо в коллекции (make_shared: одно выделение на объект и счетчик)
+    template<typename... Args>
+    Handle emplaceItem(Args&&... args) {
+        return addItem(std::make_shared<T>(std::forward<Args>(args)...));
+    }
+    void reserve(size_t capacity);
     bool removeItem(size_t index);
+    bool remove(Handle handle);
+    // Удаляет все подходящие элементы за один проход, порядок остальных сохраняется
+    size_t removeIf(const std::function<bool(const T&)>& predicate);
     void clear();
 
+    // Подписка на изменения через методы коллекции (изменения полей машинки
+    // через указатель коллекция не видит). Возвращает номер для отписки
+    size_t subscribe(ChangeListener listener) { return changes.subscribe(std::move(listener)); }
+    bool unsubscribe(size_t id) { return changes.unsubscribe(id); }
+
+    void setRemovalMode(RemovalMode mode) { removalMode = mode; }
+    RemovalMode getRemovalMode() const { return removalMode; }
+
+    Handle handleAt(size_t index) const;
+    std::optional<size_t> rowOf(Handle handle) const;
+    bool contains(Handle handle) const { return rowOf(handle).has_value(); }
+    std::shared_ptr<T> get(Handle handle) const;
+
     std::vector<std::shared_ptr<T>> findByManufacturer(const std::string& manufacturer) const;
     std::vector<std::shared_ptr<T>> filterByCondition(Condition condition) const;
     std::vector<std::shared_ptr<T>> filterByType(CarType type) const;
@@ -235,193 +1019,733 @@ public:
     std::map<Condition, std::vector<std::shared_ptr<T>>> groupByCondition() const;
 
     size_t size() const { return items.size(); }
+    uint64_t getVersion() const { return version; }
     bool empty() const { return items.empty(); }
-    double totalValue() const;
+    // Точная сумма цен; totalValue - она же в рублях
+    Money totalMoney() const;
+    // Та же сумма по частям в нескольких потоках: результат совпадает бит в бит
+    Money totalMoney(unsigned threadCount) const;
+    double totalValue() const { return totalMoney().toDouble(); }
+
+    // k элементов с наибольшим (topK) или наименьшим (bottomK) ключом, лучшие первыми.
+    // key(const T&) возвращает сравнимое значение. Порядок коллекции не меняется:
+    // ограниченная куча, O(N log k). Равные ключи идут в порядке строк, поэтому при
+    // threadCount > 1 результат тот же (key тогда вызывается из нескольких потоков)
+    template<typename KeyFn>
+    std::vector<std::shared_ptr<T>> topK(size_t k, KeyFn key, unsigned threadCount = 1) const {
+        return selectK(k, key, threadCount, std::greater<>());
+    }
+    template<typename KeyFn>
+    std::vector<std::shared_ptr<T>> bottomK(size_t k, KeyFn key, unsigned threadCount = 1) const {
+        return selectK(k, key, threadCount, std::less<>());
+    }
 
     std::shared_ptr<T> operator[](size_t index) const;
     Collection<T>& operator+=(std::shared_ptr<T> item);
     Collection<T>& operator-=(size_t index);
 
-    auto begin() { return items.begin(); }
-    auto end() { return items.end(); }
+    // Итераторы только для чтения: строки меняются через методы коллекции
     auto begin() const { return items.begin(); }
     auto end() const { return items.end(); }
-    auto cbegin() const { return items.cbegin(); }
-    auto cend() const { return items.cend(); }
+    auto cbegin() const { return items.begin(); }
+    auto cend() const { return items.end(); }
+
+    // Согласованный снимок текущего состояния за O(1)
+    CollectionSnapshot<T> snapshot() const { return CollectionSnapshot<T>(items, name, version); }
 
     std::string getName() const { return name; }
     void setName(const std::string& name) { this->name = name; }
 
-    void displayAll() const;
+    // Все строки форматируются в один буфер и выводятся одной записью;
+    // offset/limit задают страницу (номера в выводе остаются сквозными).
+    // Общая стоимость (проход по всем строкам) выводится только с первой страницей,
+    // чтобы остальные страницы стоили пропорционально своему размеру
+    void displayAll(std::ostream& out = std::cout, size_t offset = 0,
+        size_t limit = std::numeric_limits<size_t>::max()) const;
+    void renderRange(std::string& buffer, size_t offset, size_t limit) const;
+
+    // Постраничный доступ: стоимость пропорциональна размеру страницы
+    size_t pageCount(size_t pageSize) const;
+    std::vector<std::shared_ptr<T>> page(size_t pageIndex, size_t pageSize) const;
 
     // Метод для редактирования элемента
     bool editItem(size_t index, std::shared_ptr<T> newItem) {
         if (index >= items.size() || !newItem) {
             return false;
         }
-        items[index] = newItem;
+        items.mutableAt(index) = newItem;
+        ++version;
+        notify(ChangeKind::UPDATE, index);
         return true;
     }
 
 private:
     void checkIndex(size_t index) const;
+    // Единственная проверка при отсутствии подписчиков
+    void notify(ChangeKind kind, size_t row) {
+        if (changes.active()) {
+            changes.push(Change{ kind, Handle{ slotOfRow[row], generations[slotOfRow[row]] }, row });
+        }
+    }
+    void notifyAll(ChangeKind kind) {
+        if (changes.active()) {
+            changes.push(Change{ kind, Handle{}, 0 });
+        }
+    }
+    Handle appendItem(std::shared_ptr<T>&& item);
+    uint32_t acquireSlot();
+    void releaseSlot(uint32_t slot);
+    void eraseRow(size_t index);
+    template<typename Less>
+    void sortRows(Less less);
+    template<typename KeyFn, typename Better>
+    std::vector<std::shared_ptr<T>> selectK(size_t k, KeyFn& key, unsigned threadCount, Better better) const;
 };
 
 // Реализация методов шаблонного класса 
 template<typename T>
-void Collection<T>::addItem(std::shared_ptr<T> item) {
+typename Collection<T>::Handle Collection<T>::addItem(std::shared_ptr<T> item) {
     if (!item) {
         throw std::invalid_argument("Cannot add null item to collection");
     }
-    items.push_back(item);
+    Handle handle = appendItem(std::move(item));
+    ++version;
+    notify(ChangeKind::INSERT, items.size() - 1);
+    return handle;
 }
 
 template<typename T>
-bool Collection<T>::removeItem(size_t index) {
-    checkIndex(index);
-    items.erase(items.begin() + index);
-    return true;
+template<typename ForwardIt>
+void Collection<T>::addItems(ForwardIt first, ForwardIt last) {
+    if (std::any_of(first, last, [](const std::shared_ptr<T>& item) { return !item; })) {
+        throw std::invalid_argument("Cannot add null item to collection");
+    }
+    reserve(items.size() + static_cast<size_t>(std::distance(first, last)));
+    ChangeBatch batch(*this);
+    for (; first != last; ++first) {
+        appendItem(std::shared_ptr<T>(*first));
+        notify(ChangeKind::INSERT, items.size() - 1);
+    }
+    ++version;
 }
 
 template<typename T>
-void Collection<T>::clear() {
-    items.clear();
+void Collection<T>::addItems(std::vector<std::shared_ptr<T>>&& batch) {
+    if (std::any_of(batch.begin(), batch.end(), [](const std::shared_ptr<T>& item) { return !item; })) {
+        throw std::invalid_argument("Cannot add null item to collection");
+    }
+    reserve(items.size() + batch.size());
+    ChangeBatch changeBatch(*this);
+    for (auto& item : batch) {
+        appendItem(std::move(item));
+        notify(ChangeKind::INSERT, items.size() - 1);
+    }
+    batch.clear();
+    ++version;
 }
 
 template<typename T>
-std::vector<std::shared_ptr<T>> Collection<T>::findByManufacturer(const std::string& manufacturer) const {
-    std::vector<std::shared_ptr<T>> result;
-    std::copy_if(items.begin(), items.end(), std::back_inserter(result),
-        [&manufacturer](const std::shared_ptr<T>& item) {
-            return item->getManufacturer() == manufacturer;
-        });
-    return result;
+void Collection<T>::reserve(size_t capacity) {
+    items.reserve(capacity);
+    slotOfRow.reserve(capacity);
+    rowOfSlot.reserve(capacity);
+    generations.reserve(capacity);
 }
 
+// Указатель перемещается в коллекцию без лишнего изменения счетчика ссылок
 template<typename T>
-std::vector<std::shared_ptr<T>> Collection<T>::filterByCondition(Condition condition) const {
-    std::vector<std::shared_ptr<T>> result;
-    std::copy_if(items.begin(), items.end(), std::back_inserter(result),
-        [condition](const std::shared_ptr<T>& item) {
-            Car* car = dynamic_cast<Car*>(item.get());
-            return car && car->getCondition() == condition;
-        });
-    return result;
+typename Collection<T>::Handle Collection<T>::appendItem(std::shared_ptr<T>&& item) {
+    const uint32_t slot = acquireSlot();
+    rowOfSlot[slot] = static_cast<uint32_t>(items.size());
+    items.push_back(std::move(item));
+    slotOfRow.push_back(slot);
+    return Handle{ slot, generations[slot] };
 }
 
 template<typename T>
-std::vector<std::shared_ptr<T>> Collection<T>::filterByType(CarType type) const {
-    std::vector<std::shared_ptr<T>> result;
-    std::copy_if(items.begin(), items.end(), std::back_inserter(result),
-        [type](const std::shared_ptr<T>& item) {
-            Car* car = dynamic_cast<Car*>(item.get());
-            return car && car->getType() == type;
-        });
-    return result;
+bool Collection<T>::removeItem(size_t index) {
+    checkIndex(index);
+    eraseRow(index);
+    return true;
 }
 
 template<typename T>
-void Collection<T>::sortByYear(bool ascending) {
-    std::sort(items.begin(), items.end(),
-        [ascending](const std::shared_ptr<T>& a, const std::shared_ptr<T>& b) {
-            return ascending ? a->getYear() < b->getYear() : a->getYear() > b->getYear();
-        });
+bool Collection<T>::remove(Handle handle) {
+    auto row = rowOf(handle);
+    if (!row) {
+        return false;
+    }
+    eraseRow(*row);
+    return true;
 }
 
 template<typename T>
-void Collection<T>::sortByPrice(bool ascending) {
-    std::sort(items.begin(), items.end(),
-        [ascending](const std::shared_ptr<T>& a, const std::shared_ptr<T>& b) {
-            return ascending ? a->getPrice() < b->getPrice() : a->getPrice() > b->getPrice();
-        });
+size_t Collection<T>::removeIf(const std::function<bool(const T&)>& predicate) {
+    PROFILE_SCOPE("collection.removeIf");
+    // Номера строк в событиях - номера до удаления.
+    // Оставшиеся элементы собираются в новые блоки, общие блоки снимков не трогаются.
+    // Предикат вычисляется до изменения коллекции: если он бросит исключение,
+    // коллекция останется прежней
+    std::vector<char> matched(items.size());
+    size_t matchedCount = 0;
+    for (size_t i = 0; i < matched.size(); ++i) {
+        matched[i] = predicate(*items[i]) ? 1 : 0;
+        matchedCount += matched[i];
+    }
+    if (matchedCount == 0) {
+        return 0;
+    }
+
+    ChangeBatch batch(*this);
+    std::vector<std::shared_ptr<T>> all = items.takeAll();
+    size_t kept = 0;
+    for (size_t i = 0; i < all.size(); ++i) {
+        if (matched[i]) {
+            notify(ChangeKind::REMOVE, i);
+            releaseSlot(slotOfRow[i]);
+            continue;
+        }
+        if (kept != i) {
+            all[kept] = std::move(all[i]);
+            slotOfRow[kept] = slotOfRow[i];
+        }
+        rowOfSlot[slotOfRow[kept]] = static_cast<uint32_t>(kept);
+        ++kept;
+    }
+    all.resize(kept);
+    items.assign(std::move(all));
+    slotOfRow.resize(kept);
+    ++version;
+    return matchedCount;
 }
 
 template<typename T>
-void Collection<T>::sortByManufacturer(bool ascending) {
-    std::sort(items.begin(), items.end(),
-        [ascending](const std::shared_ptr<T>& a, const std::shared_ptr<T>& b) {
-            return ascending ? a->getManufacturer() < b->getManufacturer()
-                : a->getManufacturer() > b->getManufacturer();
-        });
+Collection<T>& Collection<T>::operator=(const Collection& other) {
+    if (this != &other) {
+        Collection copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
 }
 
 template<typename T>
-std::map<std::string, std::vector<std::shared_ptr<T>>> Collection<T>::groupByManufacturer() const {
-    std::map<std::string, std::vector<std::shared_ptr<T>>> groups;
-    for (const auto& item : items) {
-        groups[item->getManufacturer()].push_back(item);
+Collection<T>& Collection<T>::operator=(Collection&& other) {
+    if (this == &other) {
+        return *this;
     }
-    return groups;
+    ChangeBatch batch(*this);
+    notifyAll(ChangeKind::CLEAR);
+    std::swap(items, other.items);
+    std::swap(name, other.name);
+    std::swap(slotOfRow, other.slotOfRow);
+    std::swap(rowOfSlot, other.rowOfSlot);
+    std::swap(generations, other.generations);
+    std::swap(freeSlots, other.freeSlots);
+    removalMode = other.removalMode;
+    // Версия не должна совпасть со старой, иначе представления не заметят замены
+    version = std::max(version, other.version) + 1;
+    for (size_t row = 0; row < items.size(); ++row) {
+        notify(ChangeKind::INSERT, row);
+    }
+    return *this;
 }
 
 template<typename T>
-std::map<CarType, std::vector<std::shared_ptr<T>>> Collection<T>::groupByType() const {
-    std::map<CarType, std::vector<std::shared_ptr<T>>> groups;
-    for (const auto& item : items) {
-        Car* car = dynamic_cast<Car*>(item.get());
-        if (car) {
-            groups[car->getType()].push_back(item);
-        }
+void Collection<T>::clear() {
+    for (uint32_t slot : slotOfRow) {
+        releaseSlot(slot);
     }
-    return groups;
+    items.clear();
+    slotOfRow.clear();
+    ++version;
+    notifyAll(ChangeKind::CLEAR);
 }
 
 template<typename T>
-std::map<Condition, std::vector<std::shared_ptr<T>>> Collection<T>::groupByCondition() const {
-    std::map<Condition, std::vector<std::shared_ptr<T>>> groups;
-    for (const auto& item : items) {
-        Car* car = dynamic_cast<Car*>(item.get());
-        if (car) {
-            groups[car->getCondition()].push_back(item);
-        }
+void Collection<T>::Transaction::insert(std::shared_ptr<T> item) {
+    if (!item) {
+        throw std::invalid_argument("Cannot add null item to collection");
     }
-    return groups;
+    inserts.push_back(std::move(item));
 }
 
 template<typename T>
-double Collection<T>::totalValue() const {
-    double total = 0.0;
-    for (const auto& item : items) {
-        total += item->getPrice();
+bool Collection<T>::Transaction::update(Handle handle, std::shared_ptr<T> item) {
+    if (!item || !collection.contains(handle)) {
+        return false;
     }
-    return total;
+    updates.emplace_back(handle, std::move(item));
+    return true;
 }
 
 template<typename T>
-std::shared_ptr<T> Collection<T>::operator[](size_t index) const {
-    checkIndex(index);
-    return items[index];
+bool Collection<T>::Transaction::remove(Handle handle) {
+    if (!collection.contains(handle)) {
+        return false;
+    }
+    removals.push_back(handle);
+    return true;
 }
 
 template<typename T>
-Collection<T>& Collection<T>::operator+=(std::shared_ptr<T> item) {
-    addItem(item);
-    return *this;
+void Collection<T>::Transaction::rollback() {
+    inserts.clear();
+    updates.clear();
+    removals.clear();
 }
 
 template<typename T>
-Collection<T>& Collection<T>::operator-=(size_t index) {
+bool Collection<T>::Transaction::commit() {
+    PROFILE_SCOPE("collection.commit");
+    Collection& c = collection;
+
+    // 1. Ссылки переводятся в строки; при недействительной ссылке ничего не меняется
+    std::vector<size_t> removeRows;
+    removeRows.reserve(removals.size());
+    for (Handle handle : removals) {
+        auto row = c.rowOf(handle);
+        if (!row) {
+            return false;
+        }
+        removeRows.push_back(*row);
+    }
+    std::sort(removeRows.begin(), removeRows.end());
+    removeRows.erase(std::unique(removeRows.begin(), removeRows.end()), removeRows.end());
+    auto removed = [&removeRows](size_t row) {
+        return std::binary_search(removeRows.begin(), removeRows.end(), row);
+    };
+
+    std::vector<std::pair<size_t, std::shared_ptr<T>>> updateRows;
+    updateRows.reserve(updates.size());
+    for (const auto& update : updates) {
+        auto row = c.rowOf(update.first);
+        if (!row) {
+            return false;
+        }
+        if (!removed(*row)) {
+            updateRows.emplace_back(*row, update.second);
+        }
+    }
+
+    // 2. Новое состояние собирается отдельно (общие блоки копируются при записи),
+    // память таблицы слотов резервируется заранее: исключение здесь коллекцию не меняет
+    const size_t finalSize = c.items.size() - removeRows.size() + inserts.size();
+    if (c.generations.size() + inserts.size() > UINT32_MAX) {
+        throw std::length_error("Collection slot table is full");
+    }
+    ChunkedVector<std::shared_ptr<T>> next = c.items;
+    for (const auto& update : updateRows) {
+        next.mutableAt(update.first) = update.second;
+    }
+    std::vector<uint32_t> nextSlotOfRow;
+    if (!removeRows.empty()) {
+        std::vector<std::shared_ptr<T>> kept;
+        kept.reserve(finalSize);
+        nextSlotOfRow.reserve(finalSize);
+        size_t r = 0;
+        for (size_t i = 0; i < next.size(); ++i) {
+            if (r < removeRows.size() && removeRows[r] == i) {
+                ++r;
+                continue;
+            }
+            kept.push_back(next[i]);
+            nextSlotOfRow.push_back(c.slotOfRow[i]);
+        }
+        next.assign(std::move(kept));
+    }
+    next.reserve(finalSize);
+    for (const auto& item : inserts) {
+        next.push_back(item);
+    }
+    c.slotOfRow.reserve(finalSize);
+    c.generations.reserve(c.generations.size() + inserts.size());
+    c.rowOfSlot.reserve(c.rowOfSlot.size() + inserts.size());
+    c.freeSlots.reserve(c.freeSlots.size() + removeRows.size());
+
+    // 3. Применение: только перестановка указателей и запись в зарезервированную память
+    ChangeBatch batch(c);
+    for (const auto& update : updateRows) {
+        c.notify(ChangeKind::UPDATE, update.first);
+    }
+    for (size_t row : removeRows) {
+        c.notify(ChangeKind::REMOVE, row);
+        c.releaseSlot(c.slotOfRow[row]);
+    }
+    if (!removeRows.empty()) {
+        c.slotOfRow.swap(nextSlotOfRow);
+        for (size_t i = removeRows.front(); i < c.slotOfRow.size(); ++i) {
+            c.rowOfSlot[c.slotOfRow[i]] = static_cast<uint32_t>(i);
+        }
+    }
+    c.items = next;
+    for (size_t row = c.slotOfRow.size(); row < finalSize; ++row) {
+        const uint32_t slot = c.acquireSlot();
+        c.rowOfSlot[slot] = static_cast<uint32_t>(row);
+        c.slotOfRow.push_back(slot);
+        c.notify(ChangeKind::INSERT, row);
+    }
+    if (!updateRows.empty() || !removeRows.empty() || !inserts.empty()) {
+        ++c.version;
+    }
+    rollback();
+    return true;
+}
+
+template<typename T>
+typename Collection<T>::Handle Collection<T>::handleAt(size_t index) const {
+    checkIndex(index);
+    const uint32_t slot = slotOfRow[index];
+    return Handle{ slot, generations[slot] };
+}
+
+template<typename T>
+std::optional<size_t> Collection<T>::rowOf(Handle handle) const {
+    if (handle.slot >= generations.size() || generations[handle.slot] != handle.generation) {
+        return std::nullopt;
+    }
+    return rowOfSlot[handle.slot];
+}
+
+template<typename T>
+std::shared_ptr<T> Collection<T>::get(Handle handle) const {
+    auto row = rowOf(handle);
+    return row ? items[*row] : nullptr;
+}
+
+template<typename T>
+uint32_t Collection<T>::acquireSlot() {
+    if (!freeSlots.empty()) {
+        const uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    if (generations.size() >= UINT32_MAX) {
+        throw std::length_error("Collection slot table is full");
+    }
+    generations.push_back(0);
+    rowOfSlot.push_back(0);
+    return static_cast<uint32_t>(generations.size() - 1);
+}
+
+// Новое поколение делает все выданные ссылки на слот недействительными
+template<typename T>
+void Collection<T>::releaseSlot(uint32_t slot) {
+    ++generations[slot];
+    freeSlots.push_back(slot);
+}
+
+template<typename T>
+void Collection<T>::eraseRow(size_t index) {
+    ChangeBatch batch(*this);
+    notify(ChangeKind::REMOVE, index);
+    releaseSlot(slotOfRow[index]);
+    if (removalMode == RemovalMode::SWAP_AND_POP) {
+        const size_t last = items.size() - 1;
+        if (index != last) {
+            std::shared_ptr<T> moved = std::move(items.mutableAt(last));
+            items.mutableAt(index) = std::move(moved);
+            slotOfRow[index] = slotOfRow[last];
+            rowOfSlot[slotOfRow[index]] = static_cast<uint32_t>(index);
+            notify(ChangeKind::MOVE, index);
+        }
+        items.pop_back();
+        slotOfRow.pop_back();
+    }
+    else {
+        items.erase(index);
+        slotOfRow.erase(slotOfRow.begin() + index);
+        for (size_t i = index; i < items.size(); ++i) {
+            rowOfSlot[slotOfRow[i]] = static_cast<uint32_t>(i);
+        }
+    }
+    ++version;
+}
+
+// Сортирует строки вместе с их слотами, чтобы ссылки продолжали указывать на те же элементы
+template<typename T>
+template<typename Less>
+void Collection<T>::sortRows(Less less) {
+    // Память выделяется до того, как элементы покинут коллекцию
+    std::vector<std::pair<std::shared_ptr<T>, uint32_t>> rows(items.size());
+    std::vector<std::shared_ptr<T>> all = items.takeAll();
+    for (size_t i = 0; i < all.size(); ++i) {
+        rows[i] = { std::move(all[i]), slotOfRow[i] };
+    }
+    std::sort(rows.begin(), rows.end(),
+        [&less](const auto& a, const auto& b) { return less(a.first, b.first); });
+    for (size_t i = 0; i < rows.size(); ++i) {
+        all[i] = std::move(rows[i].first);
+        slotOfRow[i] = rows[i].second;
+        rowOfSlot[slotOfRow[i]] = static_cast<uint32_t>(i);
+    }
+    items.assign(std::move(all));
+    ++version;
+    notifyAll(ChangeKind::REORDER);
+}
+
+template<typename T>
+std::vector<std::shared_ptr<T>> Collection<T>::findByManufacturer(const std::string& manufacturer) const {
+    PROFILE_SCOPE("collection.findByManufacturer");
+    std::vector<std::shared_ptr<T>> result;
+    std::copy_if(items.begin(), items.end(), std::back_inserter(result),
+        [&manufacturer](const std::shared_ptr<T>& item) {
+            return item->getManufacturer() == manufacturer;
+        });
+    return result;
+}
+
+template<typename T>
+std::vector<std::shared_ptr<T>> Collection<T>::filterByCondition(Condition condition) const {
+    PROFILE_SCOPE("collection.filterByCondition");
+    std::vector<std::shared_ptr<T>> result;
+    std::copy_if(items.begin(), items.end(), std::back_inserter(result),
+        [condition](const std::shared_ptr<T>& item) {
+            Car* car = dynamic_cast<Car*>(item.get());
+            return car && car->getCondition() == condition;
+        });
+    return result;
+}
+
+template<typename T>
+std::vector<std::shared_ptr<T>> Collection<T>::filterByType(CarType type) const {
+    PROFILE_SCOPE("collection.filterByType");
+    std::vector<std::shared_ptr<T>> result;
+    std::copy_if(items.begin(), items.end(), std::back_inserter(result),
+        [type](const std::shared_ptr<T>& item) {
+            Car* car = dynamic_cast<Car*>(item.get());
+            return car && car->getType() == type;
+        });
+    return result;
+}
+
+template<typename T>
+void Collection<T>::sortByYear(bool ascending) {
+    PROFILE_SCOPE("collection.sortByYear");
+    sortRows([ascending](const std::shared_ptr<T>& a, const std::shared_ptr<T>& b) {
+        return ascending ? a->getYear() < b->getYear() : a->getYear() > b->getYear();
+    });
+}
+
+template<typename T>
+void Collection<T>::sortByPrice(bool ascending) {
+    PROFILE_SCOPE("collection.sortByPrice");
+    sortRows([ascending](const std::shared_ptr<T>& a, const std::shared_ptr<T>& b) {
+        return ascending ? a->getPriceMoney() < b->getPriceMoney() : a->getPriceMoney() > b->getPriceMoney();
+    });
+}
+
+template<typename T>
+void Collection<T>::sortByManufacturer(bool ascending) {
+    PROFILE_SCOPE("collection.sortByManufacturer");
+    sortRows([ascending](const std::shared_ptr<T>& a, const std::shared_ptr<T>& b) {
+        return ascending ? a->getManufacturer() < b->getManufacturer()
+            : a->getManufacturer() > b->getManufacturer();
+    });
+}
+
+template<typename T>
+std::map<std::string, std::vector<std::shared_ptr<T>>> Collection<T>::groupByManufacturer() const {
+    PROFILE_SCOPE("collection.groupByManufacturer");
+    std::map<std::string, std::vector<std::shared_ptr<T>>> groups;
+    for (const auto& item : items) {
+        groups[item->getManufacturer()].push_back(item);
+    }
+    return groups;
+}
+
+template<typename T>
+std::map<CarType, std::vector<std::shared_ptr<T>>> Collection<T>::groupByType() const {
+    PROFILE_SCOPE("collection.groupByType");
+    std::map<CarType, std::vector<std::shared_ptr<T>>> groups;
+    for (const auto& item : items) {
+        Car* car = dynamic_cast<Car*>(item.get());
+        if (car) {
+            groups[car->getType()].push_back(item);
+        }
+    }
+    return groups;
+}
+
+template<typename T>
+std::map<Condition, std::vector<std::shared_ptr<T>>> Collection<T>::groupByCondition() const {
+    PROFILE_SCOPE("collection.groupByCondition");
+    std::map<Condition, std::vector<std::shared_ptr<T>>> groups;
+    for (const auto& item : items) {
+        Car* car = dynamic_cast<Car*>(item.get());
+        if (car) {
+            groups[car->getCondition()].push_back(item);
+        }
+    }
+    return groups;
+}
+
+template<typename T>
+Money Collection<T>::totalMoney() const {
+    PROFILE_SCOPE("collection.totalValue");
+    int64_t total = 0;
+    for (const auto& item : items) {
+        total += item->getPriceMoney().kopecks();
+    }
+    return Money::fromKopecks(total);
+}
+
+template<typename T>
+Money Collection<T>::totalMoney(unsigned threadCount) const {
+    PROFILE_SCOPE("collection.totalValue.parallel");
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(threadCount, items.size()));
+    if (chunks == 1) {
+        return totalMoney();
+    }
+    std::vector<int64_t> partial(chunks, 0);
+    std::vector<std::thread> workers;
+    workers.reserve(chunks);
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        workers.emplace_back([this, chunk, chunks, &partial]() {
+            const size_t from = items.size() * chunk / chunks;
+            const size_t to = items.size() * (chunk + 1) / chunks;
+            int64_t sum = 0;
+            for (size_t i = from; i < to; ++i) {
+                sum += items[i]->getPriceMoney().kopecks();
+            }
+            partial[chunk] = sum;
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    int64_t total = 0;
+    for (int64_t sum : partial) {
+        total += sum;
+    }
+    return Money::fromKopecks(total);
+}
+
+template<typename T>
+template<typename KeyFn, typename Better>
+std::vector<std::shared_ptr<T>> Collection<T>::selectK(size_t k, KeyFn& key, unsigned threadCount,
+    Better better) const {
+    PROFILE_SCOPE("collection.topK");
+    using Key = std::decay_t<decltype(key(std::declval<const T&>()))>;
+    using Entry = std::pair<Key, size_t>;  // ключ и строка
+    k = std::min(k, items.size());
+    if (k == 0) {
+        return {};
+    }
+
+    // a впереди b: лучший ключ, при равных - меньшая строка
+    auto ahead = [&better](const Entry& a, const Entry& b) {
+        if (better(a.first, b.first)) {
+            return true;
+        }
+        if (better(b.first, a.first)) {
+            return false;
+        }
+        return a.second < b.second;
+    };
+    // Куча из k лучших строк диапазона, на вершине - худшая из них
+    auto selectRange = [&](size_t from, size_t to) {
+        std::vector<Entry> heap;
+        heap.reserve(k);
+        for (size_t i = from; i < to; ++i) {
+            Entry entry(key(*items[i]), i);
+            if (heap.size() < k) {
+                heap.push_back(std::move(entry));
+                std::push_heap(heap.begin(), heap.end(), ahead);
+            }
+            else if (ahead(entry, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), ahead);
+                heap.back() = std::move(entry);
+                std::push_heap(heap.begin(), heap.end(), ahead);
+            }
+        }
+        return heap;
+    };
+
+    std::vector<Entry> best;
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(threadCount, items.size() / k));
+    if (chunks == 1) {
+        best = selectRange(0, items.size());
+        std::sort_heap(best.begin(), best.end(), ahead);
+    }
+    else {
+        // Каждый поток отбирает k лучших в своей части, затем выбираются k из chunks * k
+        std::vector<std::vector<Entry>> partial(chunks);
+        std::vector<std::thread> workers;
+        workers.reserve(chunks);
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            workers.emplace_back([this, chunk, chunks, &partial, &selectRange]() {
+                partial[chunk] = selectRange(items.size() * chunk / chunks, items.size() * (chunk + 1) / chunks);
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        best.reserve(chunks * k);
+        for (auto& heap : partial) {
+            std::move(heap.begin(), heap.end(), std::back_inserter(best));
+        }
+        std::partial_sort(best.begin(), best.begin() + k, best.end(), ahead);
+        best.resize(k);
+    }
+
+    std::vector<std::shared_ptr<T>> result;
+    result.reserve(best.size());
+    for (const auto& entry : best) {
+        result.push_back(items[entry.second]);
+    }
+    return result;
+}
+
+template<typename T>
+std::shared_ptr<T> Collection<T>::operator[](size_t index) const {
+    checkIndex(index);
+    return items[index];
+}
+
+template<typename T>
+Collection<T>& Collection<T>::operator+=(std::shared_ptr<T> item) {
+    addItem(item);
+    return *this;
+}
+
+template<typename T>
+Collection<T>& Collection<T>::operator-=(size_t index) {
     removeItem(index);
     return *this;
 }
 
 template<typename T>
-void Collection<T>::displayAll() const {
-    std::cout << "\n=== Коллекция: " << name << " ===\n";
-    std::cout << "Количество машинок: " << items.size() << "\n";
-    std::cout << "Общая стоимость: " << std::fixed << std::setprecision(2) << totalValue() << " руб.\n";
-    std::cout << "========================================\n";
+void Collection<T>::renderRange(std::string& buffer, size_t offset, size_t limit) const {
+    const size_t first = std::min(offset, items.size());
+    const size_t last = first + std::min(limit, items.size() - first);
+    for (size_t i = first; i < last; ++i) {
+        buffer += std::to_string(i + 1);
+        buffer += ". ";
+        buffer += items[i]->renderedString();
+        buffer += "\n\n";
+    }
+}
 
-    if (items.empty()) {
-        std::cout << "Коллекция пуста.\n";
-        return;
+template<typename T>
+void Collection<T>::displayAll(std::ostream& out, size_t offset, size_t limit) const {
+    PROFILE_SCOPE("collection.displayAll");
+    std::ostringstream header;
+    header << "\n=== Коллекция: " << name << " ===\n";
+    header << "Количество машинок: " << items.size() << "\n";
+    if (offset == 0) {
+        header << "Общая стоимость: " << totalMoney() << " руб.\n";
     }
+    header << "========================================\n";
 
-    for (size_t i = 0; i < items.size(); ++i) {
-        std::cout << i + 1 << ". ";
-        items[i]->displayInfo();
-        std::cout << "\n";
+    std::string buffer = header.str();
+    if (items.empty()) {
+        buffer += "Коллекция пуста.\n";
     }
+    else {
+        renderRange(buffer, offset, limit);
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.flush();
 }
 
 template<typename T>
@@ -431,13 +1755,770 @@ void Collection<T>::checkIndex(size_t index) const {
     }
 }
 
+template<typename T>
+size_t Collection<T>::pageCount(size_t pageSize) const {
+    if (pageSize == 0) {
+        throw std::invalid_argument("Page size must be positive");
+    }
+    return (items.size() + pageSize - 1) / pageSize;
+}
+
+template<typename T>
+std::vector<std::shared_ptr<T>> Collection<T>::page(size_t pageIndex, size_t pageSize) const {
+    if (pageSize == 0) {
+        throw std::invalid_argument("Page size must be positive");
+    }
+    const size_t first = std::min(pageIndex * pageSize, items.size());
+    const size_t last = std::min(first + pageSize, items.size());
+    return std::vector<std::shared_ptr<T>>(items.begin() + first, items.begin() + last);
+}
+
+// Курсор по страницам: хранит только номер текущей страницы
+class PageCursor {
+public:
+    PageCursor(size_t total, size_t pageSize)
+        : total(total), pageSize(pageSize ? pageSize : 1) {}
+
+    size_t page() const { return current; }
+    size_t pageCount() const { return total ? (total + pageSize - 1) / pageSize : 1; }
+    size_t offset() const { return current * pageSize; }
+    size_t limit() const { return pageSize; }
+
+    bool next() {
+        if (current + 1 >= pageCount()) return false;
+        ++current;
+        return true;
+    }
+
+    bool prev() {
+        if (current == 0) return false;
+        --current;
+        return true;
+    }
+
+    bool goTo(size_t pageIndex) {
+        if (pageIndex >= pageCount()) return false;
+        current = pageIndex;
+        return true;
+    }
+
+private:
+    size_t total;
+    size_t pageSize;
+    size_t current = 0;
+};
+
+// Представление коллекции: выбранные элементы в нужном порядке без изменения
+// самой коллекции. Хранит устойчивые ссылки, поэтому после сортировки или
+// удаления в коллекции показывает те же машинки (удаленные пропускаются);
+// isStale сообщает, что состав или порядок коллекции изменились.
+// Страница выводится за O(размер страницы).
+template<typename T>
+class CollectionView {
+public:
+    using Handle = typename Collection<T>::Handle;
+
+    explicit CollectionView(const Collection<T>& collection)
+        : collection(&collection), version(collection.getVersion()) {
+        handles.reserve(collection.size());
+        for (size_t i = 0; i < collection.size(); ++i) {
+            handles.push_back(collection.handleAt(i));
+        }
+    }
+
+    CollectionView& filter(const std::function<bool(const T&)>& predicate) {
+        prune();
+        handles.erase(std::remove_if(handles.begin(), handles.end(),
+            [&](Handle handle) { return !predicate(at(handle)); }), handles.end());
+        return *this;
+    }
+
+    CollectionView& sortBy(const std::function<bool(const T&, const T&)>& less) {
+        prune();
+        std::stable_sort(handles.begin(), handles.end(),
+            [&](Handle a, Handle b) { return less(at(a), at(b)); });
+        return *this;
+    }
+
+    // Убирает ссылки на машинки, удаленные из коллекции
+    void prune() {
+        handles.erase(std::remove_if(handles.begin(), handles.end(),
+            [this](Handle handle) { return !collection->contains(handle); }), handles.end());
+    }
+
+    size_t size() const { return handles.size(); }
+    bool empty() const { return handles.empty(); }
+    bool isStale() const { return collection->getVersion() != version; }
+    const std::vector<Handle>& itemHandles() const { return handles; }
+
+    std::vector<std::shared_ptr<T>> page(size_t pageIndex, size_t pageSize) const {
+        std::vector<std::shared_ptr<T>> result;
+        const size_t first = std::min(pageIndex * pageSize, handles.size());
+        const size_t last = std::min(first + pageSize, handles.size());
+        for (size_t i = first; i < last; ++i) {
+            if (auto item = collection->get(handles[i])) {
+                result.push_back(std::move(item));
+            }
+        }
+        return result;
+    }
+
+    // Номера в выводе - текущие номера строк в коллекции, их можно использовать для удаления и правки
+    void renderPage(std::string& buffer, size_t offset, size_t limit) const {
+        const size_t first = std::min(offset, handles.size());
+        const size_t last = first + std::min(limit, handles.size() - first);
+        for (size_t i = first; i < last; ++i) {
+            auto row = collection->rowOf(handles[i]);
+            if (!row) {
+                continue;
+            }
+            buffer += std::to_string(*row + 1);
+            buffer += ". ";
+            buffer += collection->begin()[*row]->renderedString();
+            buffer += "\n\n";
+        }
+    }
+
+private:
+    // Доступ без копирования shared_ptr (и атомарного счетчика) на каждое сравнение;
+    // вызывается только для живых ссылок (после prune)
+    const T& at(Handle handle) const { return *collection->begin()[*collection->rowOf(handle)]; }
+
+    const Collection<T>* collection;
+    std::vector<Handle> handles;
+    uint64_t version;
+};
+
+// Коллекция, хранящая элементы по значению в одном непрерывном массиве:
+// без отдельного выделения и атомарного счетчика ссылок на каждую машинку.
+// Запросы возвращают невладеющие указатели на элементы; они действительны
+// до следующего изменения коллекции (см. getVersion).
+template<typename T>
+class ValueCollection {
+public:
+    using Refs = std::vector<const T*>;
+
+    ValueCollection() = default;
+    explicit ValueCollection(const std::string& name) : name(name) {}
+    // Копирует элементы коллекции с общими указателями
+    explicit ValueCollection(const Collection<T>& shared) : name(shared.getName()) {
+        items.reserve(shared.size());
+        for (const auto& item : shared) {
+            items.push_back(*item);
+        }
+    }
+
+    void addItem(T item) {
+        items.push_back(std::move(item));
+        ++version;
+    }
+
+    template<typename... Args>
+    T& emplaceItem(Args&&... args) {
+        items.emplace_back(std::forward<Args>(args)...);
+        ++version;
+        return items.back();
+    }
+
+    bool removeItem(size_t index) {
+        checkIndex(index);
+        items.erase(items.begin() + index);
+        ++version;
+        return true;
+    }
+
+    size_t removeIf(const std::function<bool(const T&)>& predicate) {
+        const size_t before = items.size();
+        items.erase(std::remove_if(items.begin(), items.end(), predicate), items.end());
+        if (items.size() != before) {
+            ++version;
+        }
+        return before - items.size();
+    }
+
+    void reserve(size_t capacity) { items.reserve(capacity); }
+    void clear() {
+        items.clear();
+        ++version;
+    }
+
+    Refs findByManufacturer(const std::string& manufacturer) const {
+        PROFILE_SCOPE("valueCollection.findByManufacturer");
+        return select([&manufacturer](const T& item) { return item.getManufacturer() == manufacturer; });
+    }
+
+    Refs filterByCondition(Condition condition) const {
+        PROFILE_SCOPE("valueCollection.filterByCondition");
+        return select([condition](const T& item) { return item.getCondition() == condition; });
+    }
+
+    Refs filterByType(CarType type) const {
+        PROFILE_SCOPE("valueCollection.filterByType");
+        return select([type](const T& item) { return item.getType() == type; });
+    }
+
+    Refs select(const std::function<bool(const T&)>& predicate) const {
+        Refs result;
+        for (const T& item : items) {
+            if (predicate(item)) {
+                result.push_back(&item);
+            }
+        }
+        return result;
+    }
+
+    std::map<std::string, Refs> groupByManufacturer() const {
+        PROFILE_SCOPE("valueCollection.groupByManufacturer");
+        std::map<std::string, Refs> groups;
+        for (const T& item : items) {
+            groups[item.getManufacturer()].push_back(&item);
+        }
+        return groups;
+    }
+
+    std::map<CarType, Refs> groupByType() const {
+        std::map<CarType, Refs> groups;
+        for (const T& item : items) {
+            groups[item.getType()].push_back(&item);
+        }
+        return groups;
+    }
+
+    std::map<Condition, Refs> groupByCondition() const {
+        std::map<Condition, Refs> groups;
+        for (const T& item : items) {
+            groups[item.getCondition()].push_back(&item);
+        }
+        return groups;
+    }
+
+    // Сортировка перемещает сами элементы (строки - перемещением, без копирования)
+    void sortByYear(bool ascending = true) {
+        sortItems([ascending](const T& a, const T& b) {
+            return ascending ? a.getYear() < b.getYear() : a.getYear() > b.getYear();
+        });
+    }
+
+    void sortByPrice(bool ascending = true) {
+        sortItems([ascending](const T& a, const T& b) {
+            return ascending ? a.getPriceMoney() < b.getPriceMoney() : a.getPriceMoney() > b.getPriceMoney();
+        });
+    }
+
+    void sortByManufacturer(bool ascending = true) {
+        sortItems([ascending](const T& a, const T& b) {
+            return ascending ? a.getManufacturer() < b.getManufacturer()
+                : a.getManufacturer() > b.getManufacturer();
+        });
+    }
+
+    Money totalMoney() const {
+        PROFILE_SCOPE("valueCollection.totalValue");
+        int64_t total = 0;
+        for (const T& item : items) {
+            total += item.getPriceMoney().kopecks();
+        }
+        return Money::fromKopecks(total);
+    }
+
+    double totalValue() const { return totalMoney().toDouble(); }
+
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+    uint64_t getVersion() const { return version; }
+
+    const T& operator[](size_t index) const {
+        checkIndex(index);
+        return items[index];
+    }
+
+    auto begin() const { return items.begin(); }
+    auto end() const { return items.end(); }
+
+    std::string getName() const { return name; }
+    void setName(const std::string& name) { this->name = name; }
+
+    // Обратное преобразование для кода, работающего с Collection<T>
+    Collection<T> toShared() const {
+        Collection<T> shared(name);
+        shared.reserve(items.size());
+        for (const T& item : items) {
+            shared.emplaceItem(item);
+        }
+        return shared;
+    }
+
+private:
+    template<typename Less>
+    void sortItems(Less less) {
+        PROFILE_SCOPE("valueCollection.sort");
+        std::sort(items.begin(), items.end(), less);
+        ++version;
+    }
+
+    void checkIndex(size_t index) const {
+        if (index >= items.size()) {
+            throw std::out_of_range("Index out of range");
+        }
+    }
+
+    std::vector<T> items;
+    std::string name;
+    uint64_t version = 0;
+};
+
+// Словарь строк: каждая различная строка хранится один раз и получает номер.
+// Строки лежат в deque, поэтому ключи-string_view остаются действительными
+class StringPool {
+public:
+    StringPool() = default;
+    // ids ссылается на строки из values, поэтому при копировании словарь
+    // строится заново по строкам копии. Перемещение deque не двигает строки
+    StringPool(const StringPool& other);
+    StringPool(StringPool&& other) = default;
+    StringPool& operator=(const StringPool& other);
+    StringPool& operator=(StringPool&& other) = default;
+
+    uint32_t intern(std::string_view value);
+    std::optional<uint32_t> find(std::string_view value) const;
+    const std::string& str(uint32_t id) const { return values[id]; }
+    size_t size() const { return values.size(); }
+
+private:
+    std::deque<std::string> values;
+    std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+// Компактная запись машинки для массового хранения: строки заменены номерами
+// в StringPool, цена хранится в копейках, тип/состояние/серия упакованы в байт.
+// Нет указателя на vtable и строк, поэтому запись помещается в 32 байта
+// и за один кэш-промах читаются две записи.
+struct CompactCar {
+    int64_t priceKopecks;
+    uint32_t manufacturer;
+    uint32_t model;
+    uint32_t scale;
+    uint32_t color;
+    uint16_t year;
+    uint8_t type : 3;
+    uint8_t condition : 3;
+    uint8_t limitedEdition : 1;
+
+    CarType getType() const { return static_cast<CarType>(type); }
+    Condition getCondition() const { return static_cast<Condition>(condition); }
+    Money getPriceMoney() const { return Money::fromKopecks(priceKopecks); }
+    double getPrice() const { return getPriceMoney().toDouble(); }
+
+    // Бросает std::invalid_argument, если год не помещается в 16 бит
+    static CompactCar fromCar(const Car& car, StringPool& pool);
+    Car toCar(const StringPool& pool) const;
+};
+
+static_assert(sizeof(CompactCar) <= 32, "CompactCar must fit in 32 bytes");
+
+// Таблица компактных записей со своим словарем строк
+class CompactCarTable {
+public:
+    void reserve(size_t capacity) { rows.reserve(capacity); }
+    void add(const Car& car) { rows.push_back(CompactCar::fromCar(car, pool)); }
+    void addAll(const Collection<Car>& collection);
+
+    size_t size() const { return rows.size(); }
+    bool empty() const { return rows.empty(); }
+    const CompactCar& operator[](size_t index) const { return rows.at(index); }
+    auto begin() const { return rows.begin(); }
+    auto end() const { return rows.end(); }
+    const StringPool& strings() const { return pool; }
+
+    Car toCar(size_t index) const { return rows.at(index).toCar(pool); }
+    Collection<Car> toCollection(const std::string& name = "") const;
+
+    // Запросы возвращают номера записей; сравнение строк сводится к сравнению номеров
+    std::vector<size_t> findByManufacturer(const std::string& manufacturer) const;
+    std::vector<size_t> filterByCondition(Condition condition) const;
+    std::vector<size_t> filterByType(CarType type) const;
+    int64_t totalValueKopecks() const;
+
+private:
+    StringPool pool;
+    std::vector<CompactCar> rows;
+};
+
+// Идентичность машинки при слиянии: одна и та же модель в одном масштабе и цвете
+struct CarKey {
+    std::string manufacturer;
+    std::string model;
+    int year;
+    std::string scale;
+    std::string color;
+
+    static CarKey of(const Car& car);
+    bool operator==(const CarKey& other) const;
+    bool operator!=(const CarKey& other) const { return !(*this == other); }
+};
+
+struct CarKeyHash {
+    size_t operator()(const CarKey& key) const;
+};
+
+// Итоги импорта в режиме слияния
+struct ImportStats {
+    size_t inserted = 0;  // новых машинок
+    size_t updated = 0;   // существующих, у которых изменились цена/тип/состояние/серия
+    size_t skipped = 0;   // полностью совпавших с существующими
+};
+
+// Ход загрузки файла
+struct LoadProgress {
+    uint64_t bytesDone = 0;
+    uint64_t bytesTotal = 0;
+    size_t rows = 0;
+    size_t skippedRows = 0;  // строки CSV, отброшенные из-за ошибок разбора
+    double seconds = 0.0;
+
+    double rowsPerSecond() const { return seconds > 0.0 ? rows / seconds : 0.0; }
+    // Оценка по доле прочитанных байт; 0, пока оценивать не по чему
+    double etaSeconds() const {
+        return bytesDone > 0 && bytesTotal > bytesDone ? seconds * (bytesTotal - bytesDone) / bytesDone : 0.0;
+    }
+};
+
+// Флаг отмены: выставляется из любого потока (или обработчика сигнала),
+// загрузчик проверяет его между пакетами строк
+class CancelToken {
+public:
+    void cancel() { flag.store(true, std::memory_order_relaxed); }
+    void reset() { flag.store(false, std::memory_order_relaxed); }
+    bool cancelled() const { return flag.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> flag{ false };
+};
+
+struct LoadOptions {
+    // Вызывается после каждого пакета и по окончании чтения. Для блочного формата -
+    // из рабочих потоков, но не одновременно
+    std::function<void(const LoadProgress&)> onProgress;
+    const CancelToken* cancel = nullptr;
+    size_t batchRows = 4096;
+    unsigned threadCount = 0;
+};
+
+// Регистронезависимое сравнение строк UTF-8 (латиница и кириллица)
+namespace TextUtils {
+    std::u32string decodeUtf8(const std::string& str);
+    std::u32string foldCase(const std::string& str);
+    size_t levenshtein(const std::u32string& a, const std::u32string& b);
+}
+
+// Результат нечеткого поиска: значение словаря, расстояние правки и машинки с ним
+struct FuzzyMatch {
+    std::string term;
+    size_t distance;
+    std::vector<size_t> rows;
+};
+
+// Текстовый индекс по производителю и модели.
+// Хранит словарь различных значений, триграммы словаря и номера строк коллекции;
+// поиск идет по словарю, а не по всем машинкам. Номера строк действительны
+// для версии коллекции, на которой индекс был построен (см. isStale).
+class TextIndex {
+public:
+    void build(const Collection<Car>& collection);
+    bool isStale(const Collection<Car>& collection) const;
+
+    // Номера машинок, у которых производитель или модель начинается с query
+    std::vector<size_t> findPrefix(const std::string& query) const;
+    // Номера машинок, у которых производитель или модель содержит query
+    std::vector<size_t> findSubstring(const std::string& query) const;
+    // Значения на расстоянии Левенштейна не больше maxDistance, ближайшие первыми
+    std::vector<FuzzyMatch> findFuzzy(const std::string& query, size_t maxDistance = 2) const;
+
+    size_t termCount() const { return terms.size(); }
+
+private:
+    // Узел BK-дерева над словарем: дети упорядочены по расстоянию до узла
+    struct BkNode {
+        uint32_t term;
+        std::vector<std::pair<uint32_t, uint32_t>> children; // расстояние -> узел
+    };
+
+    std::vector<size_t> collectRows(const std::vector<uint32_t>& termIds) const;
+    void buildBkTree();
+    static uint64_t trigramKey(char32_t a, char32_t b, char32_t c);
+
+    std::vector<std::u32string> terms;                          // приведенные к нижнему регистру значения
+    std::vector<std::string> originals;                         // исходное написание термов
+    std::vector<BkNode> bkTree;
+    std::vector<std::vector<size_t>> postings;                  // терм -> номера строк
+    std::vector<uint32_t> sortedTerms;                          // термы в лексикографическом порядке
+    std::unordered_map<uint64_t, std::vector<uint32_t>> trigrams; // триграмма -> термы
+    uint64_t builtVersion = 0;
+    size_t builtSize = 0;
+    bool built = false;
+};
+
 //  Класс FileHandler
 class FileHandler {
 public:
+    // Запись выполняется из снимка; перегрузки для Collection снимают его сами
     static bool exportToCSV(const Collection<Car>& collection, const std::string& filename);
+    static bool exportToCSV(const CollectionSnapshot<Car>& snapshot, const std::string& filename);
+    static void writeCSVHeader(std::ostream& out);
+    static void writeCSVRow(std::ostream& out, const Car& car);
+    // Загрузчики добавляют записи в коллекцию одним пакетом только после чтения
+    // всего файла: при ошибке чтения или отмене коллекция остается без изменений
     static bool importFromCSV(Collection<Car>& collection, const std::string& filename);
+    static bool importFromCSV(Collection<Car>& collection, const std::string& filename,
+        const LoadOptions& options);
     static bool saveToBinary(const Collection<Car>& collection, const std::string& filename);
-    static bool loadFromBinary(Collection<Car>& collection, const std::string& filename);
+    static bool saveToBinary(const CollectionSnapshot<Car>& snapshot, const std::string& filename);
+    // Загружает и старый последовательный формат, и блочный (определяется по сигнатуре)
+    static bool loadFromBinary(Collection<Car>& collection, const std::string& filename,
+        unsigned threadCount = 0);
+    static bool loadFromBinary(Collection<Car>& collection, const std::string& filename,
+        const LoadOptions& options);
+
+    // Блочный формат: заголовок, таблица смещений и блоки по BLOCK_RECORDS записей.
+    // Блоки кодируются и декодируются параллельно в threadCount потоках
+    // (0 - по числу ядер).
+    static bool saveToBinaryParallel(const Collection<Car>& collection, const std::string& filename,
+        unsigned threadCount = 0);
+    static bool saveToBinaryParallel(const CollectionSnapshot<Car>& snapshot, const std::string& filename,
+        unsigned threadCount = 0);
+
+    // Потоковое чтение без коллекции: visit получает записи по порядку, в памяти
+    // держится только текущая строка (для блочного формата - группа блоков)
+    using CarVisitor = std::function<void(std::shared_ptr<Car>)>;
+    static bool scanCSV(const std::string& filename, const CarVisitor& visit,
+        const LoadOptions& options = LoadOptions());
+    static bool scanBinary(const std::string& filename, const CarVisitor& visit,
+        const LoadOptions& options = LoadOptions());
+
+    // Импорт со слиянием: записи с уже имеющимся ключом CarKey обновляют
+    // существующую машинку вместо добавления дубликата
+    static bool mergeFromCSV(Collection<Car>& collection, const std::string& filename,
+        ImportStats& stats, const LoadOptions& options = LoadOptions());
+    static bool mergeFromBinary(Collection<Car>& collection, const std::string& filename,
+        ImportStats& stats, const LoadOptions& options = LoadOptions());
+    static ImportStats mergeInto(Collection<Car>& target, const Collection<Car>& incoming);
+
+    static constexpr char BLOCK_MAGIC[8] = { 'C', 'A', 'R', 'B', 'L', 'K', '0', '1' };
+    static constexpr uint32_t BLOCK_RECORDS = 4096;
+
+private:
+    static bool loadFromBlockBinary(Collection<Car>& collection, const std::string& filename,
+        const LoadOptions& options);
+    static bool scanBlockBinary(const std::string& filename, const CarVisitor& visit,
+        const LoadOptions& options);
+};
+
+enum class SaveFormat {
+    CSV,     // FileHandler::exportToCSV
+    BINARY,  // FileHandler::saveToBinary
+    BLOCKS   // FileHandler::saveToBinaryParallel
+};
+
+// Итог фонового сохранения
+struct SaveReport {
+    std::string filename;
+    bool success = false;
+    size_t records = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+    std::string error;  // пусто при успехе
+
+    double recordsPerSecond() const { return seconds > 0.0 ? records / seconds : 0.0; }
+    double megabytesPerSecond() const { return seconds > 0.0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0; }
+};
+
+// Фоновое сохранение: при запуске снимается снимок коллекции, запись идет
+// в отдельном потоке во временный файл, который по готовности заменяет целевой.
+// Коллекцию можно продолжать редактировать - в файл попадет состояние на момент start.
+class AsyncSave {
+public:
+    static AsyncSave start(const Collection<Car>& collection, const std::string& filename,
+        SaveFormat format);
+
+    bool ready() const;
+    // Ждет завершения; можно вызывать повторно
+    const SaveReport& wait() const { return result.get(); }
+    const std::string& getFilename() const { return filename; }
+    double elapsedSeconds() const;
+
+private:
+    AsyncSave(std::string filename, std::shared_future<SaveReport> result);
+
+    std::string filename;
+    std::shared_future<SaveReport> result;
+    std::chrono::steady_clock::time_point started;
+};
+
+// Последовательная запись блочного бинарного формата по одной машинке:
+// в памяти держится только текущий блок. Число записей задается заранее.
+class BlockBinaryWriter {
+public:
+    BlockBinaryWriter(const std::string& filename, uint64_t recordCount);
+
+    bool isOpen() const { return file.is_open(); }
+    void add(const Car& car);
+    // Дописывает последний блок и таблицу смещений; false при ошибке записи
+    // или если добавлено не recordCount записей
+    bool finish();
+
+private:
+    void flushBlock();
+
+    std::ofstream file;
+    uint64_t recordCount;
+    uint64_t written = 0;
+    std::streamoff tablePos = 0;
+    std::vector<uint64_t> table;
+    std::string buffer;
+    uint32_t bufferedRecords = 0;
+};
+
+// Параметры синтетической коллекции
+struct GeneratorConfig {
+    uint64_t seed = 42;
+    size_t manufacturerCount = 30;       // число различных производителей
+    double manufacturerSkew = 1.1;       // показатель Ципфа; 0 - равномерно
+    size_t modelsPerManufacturer = 200;
+    int minYear = 1930;
+    int maxYear = 2024;
+    double minPrice = 5.0;               // цены распределены логарифмически равномерно
+    double maxPrice = 50000.0;
+    double conditionWeights[5] = { 0.10, 0.25, 0.35, 0.20, 0.10 }; // MINT..POOR
+    double limitedEditionRate = 0.05;
+};
+
+// Детерминированный генератор машинок: одинаковый seed дает одинаковые данные
+// с той же стандартной библиотекой (собственный ГПСЧ splitmix64 вместо распределений
+// <random>). Цены и веса производителей считаются через exp/log/pow, которые
+// округляются по-разному в разных libm, поэтому между платформами цена может
+// отличаться на копейку
+class InventoryGenerator {
+public:
+    explicit InventoryGenerator(const GeneratorConfig& config);
+
+    Car next();
+    void fill(Collection<Car>& collection, size_t count);
+
+    // Потоковая запись: машинки не накапливаются в памяти
+    static bool writeCSV(const GeneratorConfig& config, uint64_t count, const std::string& filename);
+    static bool writeBinary(const GeneratorConfig& config, uint64_t count, const std::string& filename);
+
+private:
+    uint64_t nextRandom();
+    double nextUnit();
+    size_t pick(const std::vector<double>& cumulative);
+
+    GeneratorConfig config;
+    uint64_t state;
+    std::vector<std::string> manufacturers;
+    std::vector<double> manufacturerCumulative;
+    std::vector<double> conditionCumulative;
+};
+
+// Гистограмма с заданными границами: корзина i - [edges[i], edges[i + 1]),
+// значения вне диапазона считаются отдельно. Гистограммы с одинаковыми
+// границами складываются
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> edges);
+    // Границы 1-2-5 в каждом десятичном порядке от from до to (from > 0)
+    static Histogram decimal(double from, double to);
+
+    void add(double value);
+    void merge(const Histogram& other);
+
+    size_t binCount() const { return counts.size(); }
+    double lower(size_t bin) const { return edges[bin]; }
+    double upper(size_t bin) const { return edges[bin + 1]; }
+    uint64_t count(size_t bin) const { return counts[bin]; }
+    uint64_t underflow() const { return below; }
+    uint64_t overflow() const { return above; }
+    uint64_t total() const;
+
+    // Строка на корзину с полосой, пропорциональной числу значений
+    void print(std::ostream& out, size_t width = 40) const;
+
+private:
+    std::vector<double> edges;
+    std::vector<uint64_t> counts;
+    uint64_t below = 0;
+    uint64_t above = 0;
+};
+
+// Приближенные квантили за один проход (KLL-скетч): память O(k log(n/k)),
+// ошибка ранга порядка 1/k (при k = 200 - около 1%). Количество, минимум
+// и максимум точные. Скетчи объединяются merge с той же гарантией, поэтому
+// части можно считать в разных потоках или по разным файлам. Выбор при
+// сжатии берется из собственного ГПСЧ - результат воспроизводим
+class QuantileSketch {
+public:
+    explicit QuantileSketch(uint32_t k = 200);
+
+    void add(double value);
+    void merge(const QuantileSketch& other);
+
+    uint64_t count() const { return n; }
+    bool empty() const { return n == 0; }
+    double min() const { return minValue; }
+    double max() const { return maxValue; }
+    // Значение, не меньше которого доля q всех значений; NaN для пустого скетча
+    double quantile(double q) const;
+    // Доля значений, не превышающих value
+    double rank(double value) const;
+    size_t retained() const { return retainedCount; }
+
+private:
+    size_t capacity(size_t level) const;
+    void grow();
+    void compress();
+
+    uint32_t k;
+    std::vector<std::vector<double>> levels;  // значение на уровне h весит 2^h
+    uint64_t n = 0;
+    double minValue = std::numeric_limits<double>::quiet_NaN();
+    double maxValue = std::numeric_limits<double>::quiet_NaN();
+    size_t retainedCount = 0;
+    size_t maxRetained = 0;
+    uint64_t randomState = 0x9E3779B97F4A7C15ull;
+};
+
+// Распределения за один проход: гистограмма цен, машинки по десятилетиям,
+// квантили цены и оценки стоимости (calculateValue), в том числе по производителям.
+// Сводки частей коллекции или разных файлов объединяются merge
+class InventoryAnalytics {
+public:
+    explicit InventoryAnalytics(uint32_t sketchK = 200);
+
+    void add(const Car& car);
+    void merge(const InventoryAnalytics& other);
+
+    // Части коллекции обрабатываются в threadCount потоках
+    static InventoryAnalytics of(const Collection<Car>& collection, unsigned threadCount = 1);
+    // Потоковое чтение файла: записи не накапливаются в памяти
+    bool addCSV(const std::string& filename, const LoadOptions& options = LoadOptions());
+    bool addBinary(const std::string& filename, const LoadOptions& options = LoadOptions());
+
+    uint64_t count() const { return prices.count(); }
+    const Histogram& priceHistogram() const { return priceBins; }
+    const std::map<int, uint64_t>& decadeCounts() const { return decades; }
+    const QuantileSketch& priceQuantiles() const { return prices; }
+    const QuantileSketch& valueQuantiles() const { return values; }
+    const std::map<std::string, QuantileSketch>& valueByManufacturer() const { return byManufacturer; }
+
+    void print(std::ostream& out) const;
+
+private:
+    uint32_t sketchK;
+    Histogram priceBins;
+    std::map<int, uint64_t> decades;  // 1960 -> машинки 1960-1969 годов
+    QuantileSketch prices;
+    QuantileSketch values;
+    std::map<std::string, QuantileSketch> byManufacturer;
 };
 
 #endif // CAR_COLLECTION_H
\ No newline at end of file
@@ -0,0 +1,402 @@
+#include "CarCollection.h"
+#include <chrono>
+#include <unordered_set>
+#include <cstdio>
+
+//  Набор бенчмарков для Collection<Car> и FileHandler
+//
+//  Сборка: g++ -std=c++17 -O2 -o benchmark benchmark.cpp CarCollection.cpp
+//  Запуск: ./benchmark [--sizes 1000,100000,...] [--filter подстрока] [--json файл]
+//
+//  Префикс value. - те же запросы к ValueCollection<Car> (хранение по значению),
+//  compact. - к CompactCarTable (32-байтовые записи).
+//  Для каждого размера InventoryGenerator строит синтетическую коллекцию
+//  с перекосом производителей по закону Ципфа (несколько марок встречаются намного чаще).
+//  Результаты печатаются таблицей и, при --json, сохраняются в машиночитаемом виде.
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::shared_ptr<Car>> generateInventory(size_t count, uint64_t seed) {
+        GeneratorConfig config;
+        config.seed = seed;
+        InventoryGenerator generator(config);
+
+        std::vector<std::shared_ptr<Car>> cars;
+        cars.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            cars.push_back(std::make_shared<Car>(generator.next()));
+        }
+        return cars;
+    }
+
+    struct Result {
+        std::string name;
+        size_t size;
+        double ms;
+        uint64_t allocations;  // 0, если сборка без -DCARS_ALLOC_TRACKING
+        uint64_t bytes;
+    };
+
+    class Suite {
+    public:
+        Suite(std::string filter) : filter(std::move(filter)) {}
+
+        bool selected(const std::string& name) const {
+            return filter.empty() || name.find(filter) != std::string::npos;
+        }
+
+        // Выполняет шаг, если его имя проходит фильтр; время включает только step.
+        // Шаги-подготовки (addItem, export/save) при отфильтрованном замере
+        // вызывающий выполняет сам, без измерения
+        void run(const std::string& name, size_t size, const std::function<void()>& step) {
+            if (!selected(name)) {
+                return;
+            }
+            const uint64_t allocationsBefore = AllocProfile::allocationCount();
+            const uint64_t bytesBefore = AllocProfile::allocatedBytes();
+            auto start = Clock::now();
+            step();
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            results.push_back(Result{ name, size, ms,
+                AllocProfile::allocationCount() - allocationsBefore,
+                AllocProfile::allocatedBytes() - bytesBefore });
+
+            std::cout << std::left << std::setw(34) << name << std::right
+                << std::setw(10) << size
+                << std::setw(12) << std::fixed << std::setprecision(2) << ms << " мс"
+                << std::setw(12) << std::setprecision(1) << nsPerItem(results.back()) << " нс/эл"
+                << std::setw(14) << std::setprecision(0) << itemsPerSecond(results.back()) << " эл/с";
+            if (AllocProfile::ENABLED) {
+                std::cout << std::setw(12) << results.back().allocations << " выдел."
+                    << std::setw(14) << results.back().bytes << " байт";
+            }
+            std::cout << "\n";
+        }
+
+        bool writeJson(const std::string& filename) const {
+            std::ofstream out(filename);
+            if (!out.is_open()) {
+                std::cerr << "Ошибка открытия файла: " << filename << std::endl;
+                return false;
+            }
+            out << "{\n  \"benchmarks\": [\n";
+            for (size_t i = 0; i < results.size(); ++i) {
+                const Result& r = results[i];
+                out << "    {\"name\": \"" << r.name << "\", \"size\": " << r.size
+                    << std::fixed << std::setprecision(6)
+                    << ", \"ms\": " << r.ms
+                    << ", \"ns_per_item\": " << nsPerItem(r)
+                    << ", \"items_per_sec\": " << itemsPerSecond(r);
+                if (AllocProfile::ENABLED) {
+                    out << ", \"allocations\": " << r.allocations << ", \"alloc_bytes\": " << r.bytes;
+                }
+                out << "}"
+                    << (i + 1 < results.size() ? "," : "") << "\n";
+            }
+            out << "  ]\n}\n";
+            return out.good();
+        }
+
+    private:
+        static double nsPerItem(const Result& r) {
+            return r.size ? r.ms * 1e6 / r.size : 0.0;
+        }
+
+        static double itemsPerSecond(const Result& r) {
+            return r.ms > 0.0 ? r.size * 1000.0 / r.ms : 0.0;
+        }
+
+        std::string filter;
+        std::vector<Result> results;
+    };
+
+    // Не дает компилятору выбросить вычисления, результат которых не используется
+    volatile size_t sink = 0;
+
+    void benchmarkCollection(Suite& suite, size_t n) {
+        const auto inventory = generateInventory(n, 42);
+
+        Collection<Car> collection("bench");
+        auto addAll = [&]() {
+            for (const auto& car : inventory) {
+                collection.addItem(car);
+            }
+        };
+        suite.run("addItem", n, addAll);
+        if (collection.empty()) {
+            addAll();
+        }
+
+        // Стоимость уведомлений: без подписчиков - одна проверка на изменение
+        Collection<Car> observed;
+        size_t events = 0;
+        observed.subscribe([&events](const std::vector<Collection<Car>::Change>& batch) { events += batch.size(); });
+        suite.run("addItem.subscribed", n, [&]() {
+            for (const auto& car : inventory) {
+                observed.addItem(car);
+            }
+        });
+        sink = sink + events;
+
+        // Пакетная вставка и создание на месте: меньше перевыделений вектора
+        // (видно по числу выделений в сборке с -DCARS_ALLOC_TRACKING)
+        // и меньше атомарных изменений счетчика ссылок
+        Collection<Car> batch;
+        suite.run("addItems", n, [&]() { batch.addItems(inventory.begin(), inventory.end()); });
+        Collection<Car> emplaced;
+        suite.run("emplaceItem", n, [&]() {
+            emplaced.reserve(n);
+            for (const auto& car : inventory) {
+                emplaced.emplaceItem(*car);
+            }
+        });
+        sink = sink + batch.size() + emplaced.size();
+
+        suite.run("findByManufacturer", n, [&]() { sink = sink + collection.findByManufacturer("Porsche").size(); });
+        suite.run("filterByCondition", n, [&]() { sink = sink + collection.filterByCondition(Condition::MINT).size(); });
+        suite.run("filterByType", n, [&]() { sink = sink + collection.filterByType(CarType::DIE_CAST).size(); });
+        suite.run("groupByManufacturer", n, [&]() { sink = sink + collection.groupByManufacturer().size(); });
+        suite.run("groupByType", n, [&]() { sink = sink + collection.groupByType().size(); });
+        suite.run("groupByCondition", n, [&]() { sink = sink + collection.groupByCondition().size(); });
+        suite.run("totalValue", n, [&]() { sink = sink + static_cast<size_t>(collection.totalValue()); });
+        suite.run("totalValue.parallel", n, [&]() {
+            sink = sink + static_cast<size_t>(collection.totalMoney(std::thread::hardware_concurrency()).kopecks());
+        });
+        suite.run("calculateValue", n, [&]() {
+            Money total;
+            for (const auto& car : collection) {
+                total += car->calculateValue();
+            }
+            sink = sink + static_cast<size_t>(total.kopecks());
+        });
+        // 50 самых ценных без сортировки всей коллекции
+        auto carValue = [](const Car& car) { return car.calculateValue(); };
+        suite.run("topK.value", n, [&]() { sink = sink + collection.topK(50, carValue).size(); });
+        suite.run("topK.value.parallel", n, [&]() {
+            sink = sink + collection.topK(50, carValue, std::thread::hardware_concurrency()).size();
+        });
+        // Гистограммы и квантили за один проход
+        suite.run("analytics", n, [&]() { sink = sink + InventoryAnalytics::of(collection).count(); });
+        suite.run("analytics.parallel", n, [&]() {
+            sink = sink + InventoryAnalytics::of(collection, std::thread::hardware_concurrency()).count();
+        });
+        std::ostringstream rendered;
+        suite.run("displayAll.cold", n, [&]() { collection.displayAll(rendered); });
+        rendered.str("");
+        suite.run("displayAll.cached", n, [&]() { collection.displayAll(rendered); });
+        sink = sink + rendered.str().size();
+
+        suite.run("sortByYear", n, [&]() { collection.sortByYear(true); });
+        suite.run("sortByPrice", n, [&]() { collection.sortByPrice(false); });
+        suite.run("sortByManufacturer", n, [&]() { collection.sortByManufacturer(true); });
+
+        // Хранение по значению: запросы возвращают указатели без счетчика ссылок
+        ValueCollection<Car> byValue;
+        suite.run("value.build", n, [&]() { byValue = ValueCollection<Car>(collection); });
+        if (!suite.selected("value.build")) byValue = ValueCollection<Car>(collection);
+        suite.run("value.findByManufacturer", n, [&]() { sink = sink + byValue.findByManufacturer("Porsche").size(); });
+        suite.run("value.filterByCondition", n, [&]() { sink = sink + byValue.filterByCondition(Condition::MINT).size(); });
+        suite.run("value.filterByType", n, [&]() { sink = sink + byValue.filterByType(CarType::DIE_CAST).size(); });
+        suite.run("value.groupByManufacturer", n, [&]() { sink = sink + byValue.groupByManufacturer().size(); });
+        suite.run("value.totalValue", n, [&]() { sink = sink + static_cast<size_t>(byValue.totalValue()); });
+        suite.run("value.sortByPrice", n, [&]() { byValue.sortByPrice(false); });
+
+        // Компактные записи: сканирование читает 32 байта на машинку подряд,
+        // без перехода по указателю в отдельный блок кучи
+        CompactCarTable compact;
+        suite.run("compact.build", n, [&]() { compact.addAll(collection); });
+        if (!suite.selected("compact.build")) compact.addAll(collection);
+        suite.run("compact.findByManufacturer", n, [&]() { sink = sink + compact.findByManufacturer("Porsche").size(); });
+        suite.run("compact.filterByCondition", n, [&]() { sink = sink + compact.filterByCondition(Condition::MINT).size(); });
+        suite.run("compact.filterByType", n, [&]() { sink = sink + compact.filterByType(CarType::DIE_CAST).size(); });
+        suite.run("compact.totalValue", n, [&]() { sink = sink + static_cast<size_t>(compact.totalValueKopecks()); });
+
+        // Снимок за O(1) и первая запись после него (копия таблицы и одного блока)
+        Collection<Car> edited(collection);
+        suite.run("snapshot", n, [&]() { sink = sink + edited.snapshot().size(); });
+        auto held = edited.snapshot();
+        suite.run("editItem.afterSnapshot", 1, [&]() { edited.editItem(n / 2, inventory.front()); });
+        sink = sink + held.size();
+
+        // Удаление: сдвиг строк против перестановки последней и массовое удаление
+        Collection<Car> pruned(collection);
+        suite.run("removeIf", n, [&]() {
+            sink = sink + pruned.removeIf([](const Car& car) { return car.getCondition() == Condition::POOR; });
+        });
+        const size_t removals = std::min<size_t>(n, 1000);
+        Collection<Car> shifting(collection);
+        suite.run("removeItem.preserveOrder", removals, [&]() {
+            for (size_t i = 0; i < removals; ++i) {
+                shifting.removeItem(0);
+            }
+        });
+        Collection<Car> swapping(collection);
+        swapping.setRemovalMode(RemovalMode::SWAP_AND_POP);
+        suite.run("removeItem.swapAndPop", removals, [&]() {
+            for (size_t i = 0; i < removals; ++i) {
+                swapping.removeItem(0);
+            }
+        });
+        // Транзакция: удаления, замены и вставки применяются за один проход
+        Collection<Car> transacted(collection);
+        suite.run("transaction.commit", removals, [&]() {
+            Collection<Car>::Transaction transaction(transacted);
+            for (size_t i = 0; i + 1 < removals; i += 2) {
+                transaction.remove(transacted.handleAt(i));
+                transaction.update(transacted.handleAt(i + 1), inventory[i]);
+                transaction.insert(inventory[i + 1]);
+            }
+            transaction.commit();
+        });
+        Collection<Car> merged(collection);
+        suite.run("mergeInto", n, [&]() {
+            ImportStats stats = FileHandler::mergeInto(merged, collection);
+            sink = sink + stats.skipped;
+        });
+
+        suite.run("textIndex.build", n, [&]() {
+            TextIndex index;
+            index.build(collection);
+            sink = sink + index.termCount();
+        });
+
+        // Проверка членства: unordered_set<Car> против двоичного поиска
+        std::vector<Car> values;
+        values.reserve(n);
+        for (const auto& car : inventory) {
+            values.push_back(*car);
+        }
+        std::unordered_set<Car> set(values.begin(), values.end());
+        suite.run("unordered_set<Car>.count", n, [&]() {
+            size_t hits = 0;
+            for (const auto& car : values) {
+                hits += set.count(car);
+            }
+            sink = sink + hits;
+        });
+        std::vector<Car> sorted(values);
+        auto fullLess = [](const Car& a, const Car& b) {
+            if (a.getManufacturer() != b.getManufacturer()) return a.getManufacturer() < b.getManufacturer();
+            if (a.getModel() != b.getModel()) return a.getModel() < b.getModel();
+            if (a.getYear() != b.getYear()) return a.getYear() < b.getYear();
+            if (a.getScale() != b.getScale()) return a.getScale() < b.getScale();
+            if (a.getColor() != b.getColor()) return a.getColor() < b.getColor();
+            if (a.getPrice() != b.getPrice()) return a.getPrice() < b.getPrice();
+            if (a.getType() != b.getType()) return a.getType() < b.getType();
+            if (a.getCondition() != b.getCondition()) return a.getCondition() < b.getCondition();
+            return a.isLimitedEdition() < b.isLimitedEdition();
+        };
+        std::sort(sorted.begin(), sorted.end(), fullLess);
+        suite.run("sortedVector<Car>.binary_search", n, [&]() {
+            size_t hits = 0;
+            for (const auto& car : values) {
+                hits += std::binary_search(sorted.begin(), sorted.end(), car, fullLess) ? 1 : 0;
+            }
+            sink = sink + hits;
+        });
+    }
+
+    void benchmarkFiles(Suite& suite, size_t n) {
+        Collection<Car> collection("bench");
+        for (const auto& car : generateInventory(n, 7)) {
+            collection.addItem(car);
+        }
+
+        const std::string csv = "bench_tmp.csv";
+        const std::string bin = "bench_tmp.bin";
+        const std::string blocks = "bench_tmp_blocks.bin";
+
+        // Файлы для замеров загрузки создаются, даже если замер записи отфильтрован
+        if (!suite.selected("exportToCSV")) FileHandler::exportToCSV(collection, csv);
+        if (!suite.selected("saveToBinary")) FileHandler::saveToBinary(collection, bin);
+        if (!suite.selected("saveToBinaryParallel")) FileHandler::saveToBinaryParallel(collection, blocks);
+
+        suite.run("exportToCSV", n, [&]() { FileHandler::exportToCSV(collection, csv); });
+        suite.run("importFromCSV", n, [&]() {
+            Collection<Car> loaded;
+            FileHandler::importFromCSV(loaded, csv);
+            sink = sink + loaded.size();
+        });
+        suite.run("saveToBinary", n, [&]() { FileHandler::saveToBinary(collection, bin); });
+        suite.run("loadFromBinary", n, [&]() {
+            Collection<Car> loaded;
+            FileHandler::loadFromBinary(loaded, bin);
+            sink = sink + loaded.size();
+        });
+        suite.run("saveToBinaryParallel", n, [&]() { FileHandler::saveToBinaryParallel(collection, blocks); });
+        suite.run("loadFromBinary.blocks", n, [&]() {
+            Collection<Car> loaded;
+            FileHandler::loadFromBinary(loaded, blocks);
+            sink = sink + loaded.size();
+        });
+
+        std::remove(csv.c_str());
+        std::remove(bin.c_str());
+        std::remove(blocks.c_str());
+    }
+
+    // Память на машинку без учета строк в куче (короткие строки хранятся внутри объекта).
+    // Блок make_shared: счетчики ссылок и Car в одном выделении
+    void printMemoryPerCar() {
+        const size_t controlBlock = 2 * sizeof(long) + sizeof(void*);
+        const size_t shared = sizeof(std::shared_ptr<Car>) + controlBlock + sizeof(Car)
+            + 3 * sizeof(uint32_t);  // таблица слотов Collection
+        std::cout << "Память на машинку: Collection<Car> ~" << shared
+            << " байт (1 выделение на машинку), ValueCollection<Car> " << sizeof(Car)
+            << " байт (без отдельных выделений), CompactCar " << sizeof(CompactCar)
+            << " байт (строки в общем словаре)\n";
+    }
+
+    std::vector<size_t> parseSizes(const std::string& list) {
+        std::vector<size_t> sizes;
+        std::stringstream ss(list);
+        std::string token;
+        while (std::getline(ss, token, ',')) {
+            sizes.push_back(static_cast<size_t>(std::stoull(token)));
+        }
+        return sizes;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes{ 1000, 10000, 100000 };
+    std::string filter;
+    std::string jsonFile;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--sizes" && i + 1 < argc) {
+                sizes = parseSizes(argv[++i]);
+            }
+            else if (arg == "--filter" && i + 1 < argc) {
+                filter = argv[++i];
+            }
+            else if (arg == "--json" && i + 1 < argc) {
+                jsonFile = argv[++i];
+            }
+            else {
+                std::cerr << "Использование: benchmark [--sizes 1000,100000,...] [--filter подстрока] [--json файл]\n";
+                return 1;
+            }
+        }
+    }
+    catch (const std::exception&) {
+        std::cerr << "Неверный список размеров\n";
+        return 1;
+    }
+
+    Suite suite(filter);
+    printMemoryPerCar();
+    for (size_t n : sizes) {
+        std::cout << "\n=== " << n << " машинок ===\n";
+        benchmarkCollection(suite, n);
+        benchmarkFiles(suite, n);
+    }
+
+    if (!jsonFile.empty() && !suite.writeJson(jsonFile)) {
+        return 2;
+    }
+    return 0;
+}
@@ -6,6 +6,12 @@
 #include <cassert>
 #include <fstream>
 #include <sstream>
+#include <unordered_set>
+#include <numeric>
+#include <chrono>
+#include <cstdio>
+#include <cctype>
+#include <csignal>
 
 //  Вспомогательные функции для тестирования 
 void printTestResult(const std::string& testName, bool passed) {
@@ -21,6 +27,12 @@ void printSectionHeader(const std::string& sectionName) {
     std::cout << std::string(sectionName.length(), '-') << "\n";
 }
 
+// Машинка для тестов событий и транзакций: различаются только модель и цена
+std::shared_ptr<Car> makeTestCar(const std::string& model, double price) {
+    return std::make_shared<Car>("Maker", model, 2000, price, CarType::DIE_CAST,
+        Condition::GOOD, "1:64", "Серый", false);
+}
+
 
 void runUnitTests() {
     std::cout << "=== ЗАПУСК UNIT-ТЕСТОВ ===\n\n";
@@ -128,8 +140,8 @@ void runUnitTests() {
             assert(carInfo.find("911") != std::string::npos);
             
             // Проверка calculateValue() - должно возвращать положительное число
-            double value = car.calculateValue();
-            assert(value > 0.0);
+            Money value = car.calculateValue();
+            assert(value > Money());
             
             // Проверка isValuable() - должен выполняться без ошибок
             bool isValuable = car.isValuable();
@@ -164,6 +176,57 @@ void runUnitTests() {
             printTestResult("Клонирование создает идентичную копию", true);
         }
         
+        // Тест 2.4: Хеширование Car
+        {
+            totalTests++;
+            Car a("Ferrari", "F40", 1987, 15000.0,
+                CarType::SCALE_MODEL, Condition::MINT, "1:18", "Red", true);
+            Car b(a);
+            Car c("Ferrari", "F40", 1987, 15000.0,
+                CarType::SCALE_MODEL, Condition::MINT, "1:43", "Red", true);
+
+            assert(a == b);
+            assert(a != c);
+            assert(std::hash<Car>()(a) == std::hash<Car>()(b));
+            assert(std::hash<Car>()(a) != std::hash<Car>()(c));
+            assert(CarKeyHash()(CarKey::of(a)) == std::hash<Car>()(a));
+
+            std::unordered_set<Car> set{ a, b, c };
+            assert(set.size() == 2);
+            assert(set.count(c) == 1);
+
+            passedTests++;
+            printTestResult("std::hash<Car> согласован с operator==", true);
+        }
+
+        // Тест 2.5: Таблицы названий перечислений
+        {
+            totalTests++;
+            static_assert(EnumUtils::carTypeToStrEN(CarType::DIE_CAST) == "Die Cast", "таблица типов");
+            static_assert(*EnumUtils::parseCondition("Fair") == Condition::FAIR, "разбор состояния");
+
+            for (int i = 0; i < 5; ++i) {
+                CarType type = static_cast<CarType>(i);
+                Condition condition = static_cast<Condition>(i);
+                assert(EnumUtils::stringToCarType(EnumUtils::carTypeToStrEN(type)) == type);
+                assert(EnumUtils::stringToCondition(EnumUtils::conditionToStrEN(condition)) == condition);
+            }
+
+            assert(!EnumUtils::parseCarType("Scale model"));
+            assert(!EnumUtils::parseCondition("Meh"));
+            bool thrown = false;
+            try {
+                EnumUtils::stringToCondition("Broken");
+            }
+            catch (const std::invalid_argument&) {
+                thrown = true;
+            }
+            assert(thrown);
+
+            passedTests++;
+            printTestResult("Названия перечислений разбираются без умолчаний", true);
+        }
+        
         // ТЕСТ 3: Collection 
         printSectionHeader("3. ТЕСТИРОВАНИЕ COLLECTION");
         
@@ -315,6 +378,611 @@ void runUnitTests() {
             printTestResult("Группировка работает корректно", true);
         }
         
+        // Тест 3.6: Текстовый индекс
+        {
+            totalTests++;
+            Collection<Car> collection("Текстовый поиск");
+
+            collection.addItem(std::make_shared<Car>("Lamborghini", "Countach", 1974, 18000.0,
+                CarType::SCALE_MODEL, Condition::GOOD, "1:18", "White", true));
+            collection.addItem(std::make_shared<Car>("Porsche", "911 Carrera", 1973, 12000.0,
+                CarType::DIE_CAST, Condition::EXCELLENT, "1:24", "Silver", false));
+            collection.addItem(std::make_shared<Car>("ГАЗ", "Волга", 1970, 3000.0,
+                CarType::DIE_CAST, Condition::GOOD, "1:43", "Черный", false));
+
+            TextIndex index;
+            assert(index.isStale(collection));
+            index.build(collection);
+            assert(!index.isStale(collection));
+
+            assert(index.findPrefix("lambo") == std::vector<size_t>{ 0 });
+            assert(index.findPrefix("911") == std::vector<size_t>{ 1 });
+            assert(index.findSubstring("CARRERA") == std::vector<size_t>{ 1 });
+            assert(index.findSubstring("рш").empty());
+            assert(index.findSubstring("ОЛГ") == std::vector<size_t>{ 2 });
+            assert(index.findPrefix("газ") == std::vector<size_t>{ 2 });
+            assert(index.findSubstring("r").size() == 2);
+
+            // Нечеткий поиск по словарю с опечатками
+            auto fuzzy = index.findFuzzy("Porshe", 2);
+            assert(!fuzzy.empty());
+            assert(fuzzy[0].term == "Porsche" && fuzzy[0].distance == 1);
+            assert(fuzzy[0].rows == std::vector<size_t>{ 1 });
+            assert(index.findFuzzy("Lamborgini", 1)[0].term == "Lamborghini");
+            assert(index.findFuzzy("Вольга", 1)[0].term == "Волга");
+            assert(index.findFuzzy("Ferari", 1).empty());
+
+            collection.sortByYear(true);
+            assert(index.isStale(collection));
+
+            passedTests++;
+            printTestResult("Поиск по началу, части названия и с опечатками", true);
+        }
+        
+        // Тест 3.7: Кэш строкового представления и постраничный вывод
+        {
+            totalTests++;
+            Collection<Car> collection("Вывод");
+            auto car = std::make_shared<Car>("Ford", "Mustang", 1967, 8500.0,
+                CarType::SCALE_MODEL, Condition::EXCELLENT, "1:18", "Blue", false);
+            collection.addItem(car);
+            collection.addItem(std::make_shared<Car>("Chevrolet", "Camaro", 1969, 9000.0,
+                CarType::DIE_CAST, Condition::GOOD, "1:24", "Yellow", true));
+            collection.addItem(std::make_shared<Car>("Dodge", "Charger", 1970, 9500.0,
+                CarType::DIE_CAST, Condition::FAIR, "1:24", "Black", false));
+
+            assert(car->renderedString() == car->toString());
+            car->setPrice(9999.5);
+            assert(car->renderedString().find("9999.50") != std::string::npos);
+            car->setColor("Red");
+            assert(car->renderedString().find("Цвет: Red") != std::string::npos);
+
+            std::ostringstream page;
+            collection.displayAll(page, 1, 1);
+            assert(page.str().find("Количество машинок: 3") != std::string::npos);
+            assert(page.str().find("2. Chevrolet Camaro") != std::string::npos);
+            assert(page.str().find("Mustang") == std::string::npos);
+            assert(page.str().find("Charger") == std::string::npos);
+            assert(page.str().find("Общая стоимость") == std::string::npos);
+
+            std::ostringstream all;
+            collection.displayAll(all);
+            assert(all.str().find("3. Dodge Charger") != std::string::npos);
+            assert(all.str().find("Общая стоимость") != std::string::npos);
+
+            // Страницы и представления
+            assert(collection.pageCount(2) == 2);
+            assert(collection.page(1, 2).size() == 1);
+            assert(collection.page(1, 2)[0]->getModel() == "Charger");
+            assert(collection.page(5, 2).empty());
+
+            CollectionView<Car> view(collection);
+            view.filter([](const Car& c) { return c.getType() == CarType::DIE_CAST; })
+                .sortBy([](const Car& a, const Car& b) { return a.getPrice() > b.getPrice(); });
+            assert(view.size() == 2);
+            assert(view.page(0, 1)[0]->getModel() == "Charger");
+            std::string viewPage;
+            view.renderPage(viewPage, 1, 1);
+            assert(viewPage.find("2. Chevrolet Camaro") != std::string::npos);
+            assert(collection[0]->getModel() == "Mustang");
+
+            PageCursor cursor(view.size(), 1);
+            assert(cursor.pageCount() == 2);
+            bool movedNext = cursor.next();
+            bool movedPastLast = cursor.next();
+            assert(movedNext && !movedPastLast);
+            assert(cursor.offset() == 1);
+            bool movedPrev = cursor.prev();
+            bool movedBeforeFirst = cursor.prev();
+            assert(movedPrev && !movedBeforeFirst);
+
+            assert(!view.isStale());
+            collection.sortByYear(false);
+            assert(view.isStale());
+
+            passedTests++;
+            printTestResult("Кэшированный вывод, страницы и представления", true);
+        }
+        
+        // Тест 3.9: Устойчивые ссылки и удаление за O(1)
+        {
+            totalTests++;
+            Collection<Car> collection("Ссылки");
+            std::vector<Collection<Car>::Handle> handles;
+            const Condition conditions[] = { Condition::POOR, Condition::MINT, Condition::POOR,
+                Condition::GOOD, Condition::POOR };
+            for (int i = 0; i < 5; ++i) {
+                handles.push_back(collection.addItem(std::make_shared<Car>("Maker", "M" + std::to_string(i),
+                    2000 + i, 100.0 * (i + 1), CarType::DIE_CAST, conditions[i], "1:64", "Синий", false)));
+            }
+
+            // Сортировка переставляет строки, ссылки указывают на те же машинки
+            collection.sortByPrice(false);
+            assert(collection.get(handles[0])->getModel() == "M0");
+            assert(*collection.rowOf(handles[0]) == 4);
+
+            CollectionView<Car> view(collection);
+            view.sortBy([](const Car& a, const Car& b) { return a.getYear() < b.getYear(); });
+
+            // Перестановка последней строки на место удаленной
+            collection.setRemovalMode(RemovalMode::SWAP_AND_POP);
+            bool removedFirst = collection.removeItem(0);  // M4
+            assert(removedFirst);
+            assert(collection.size() == 4);
+            assert(collection[0]->getModel() == "M0");
+            assert(!collection.contains(handles[4]));
+            assert(collection.get(handles[4]) == nullptr);
+            bool removedStale = collection.remove(handles[4]);
+            assert(!removedStale);
+            assert(*collection.rowOf(handles[0]) == 0);
+
+            // Освобожденный слот получает новое поколение
+            auto reused = collection.addItem(std::make_shared<Car>("Maker", "M5", 2005, 50.0,
+                CarType::DIE_CAST, Condition::FAIR, "1:64", "Синий", false));
+            assert(reused.slot == handles[4].slot && reused != handles[4]);
+            assert(!collection.contains(handles[4]));
+
+            // Массовое удаление за один проход
+            size_t removed = collection.removeIf([](const Car& c) { return c.getCondition() == Condition::POOR; });
+            assert(removed == 2);
+            assert(collection.size() == 3);
+            assert(collection.get(handles[1])->getModel() == "M1");
+            assert(collection.get(handles[3])->getModel() == "M3");
+            assert(collection.get(reused)->getModel() == "M5");
+            for (size_t i = 0; i < collection.size(); ++i) {
+                assert(collection.rowOf(collection.handleAt(i)) == i);
+            }
+
+            // Представление пропускает удаленные машинки и печатает текущие номера
+            assert(view.isStale());
+            view.prune();
+            assert(view.size() == 2);
+            std::string page;
+            view.renderPage(page, 0, 10);
+            assert(page.find(std::to_string(*collection.rowOf(handles[1]) + 1) + ". Maker M1") != std::string::npos);
+            assert(page.find("M0") == std::string::npos);
+
+            passedTests++;
+            printTestResult("Устойчивые ссылки и удаление за O(1)", true);
+        }
+        
+        // Тест 3.10: Пакетное добавление и создание на месте
+        {
+            totalTests++;
+            Collection<Car> collection("Пакет");
+            collection.reserve(4);
+            assert(collection.empty());
+
+            std::vector<std::shared_ptr<Car>> batch;
+            batch.push_back(std::make_shared<Car>("Mazda", "RX-7", 1992, 800.0,
+                CarType::DIE_CAST, Condition::GOOD, "1:43", "Красный", false));
+            batch.push_back(std::make_shared<Car>("Nissan", "Skyline", 1999, 900.0,
+                CarType::DIE_CAST, Condition::MINT, "1:43", "Синий", false));
+            auto first = batch[0];
+            const uint64_t before = collection.getVersion();
+            collection.addItems(std::move(batch));
+            assert(batch.empty());
+            assert(collection.size() == 2);
+            assert(collection.getVersion() == before + 1);
+            assert(first.use_count() == 2);  // указатель перемещен, а не скопирован
+
+            auto handle = collection.emplaceItem("Honda", "NSX", 1990, 1000.0,
+                CarType::SCALE_MODEL, Condition::EXCELLENT, "1:18", "Белый", true);
+            assert(collection.get(handle)->getModel() == "NSX");
+
+            Collection<Car> copy;
+            copy.addItems(collection.begin(), collection.end());
+            assert(copy.size() == 3 && copy[2] == collection[2]);
+
+            std::vector<std::shared_ptr<Car>> broken{ std::make_shared<Car>(), nullptr };
+            bool threw = false;
+            try {
+                copy.addItems(broken.begin(), broken.end());
+            }
+            catch (const std::invalid_argument&) {
+                threw = true;
+            }
+            assert(threw && copy.size() == 3);
+
+            passedTests++;
+            printTestResult("Пакетное добавление и создание на месте", true);
+        }
+        
+        // Тест 3.11: Коллекция с хранением по значению
+        {
+            totalTests++;
+            Collection<Car> shared("Значения");
+            shared.emplaceItem("Toyota", "Supra", 1994, 700.0, CarType::DIE_CAST,
+                Condition::POOR, "1:24", "Оранжевый", false);
+            shared.emplaceItem("BMW", "M3", 1988, 500.0, CarType::SCALE_MODEL,
+                Condition::MINT, "1:18", "Белый", true);
+
+            ValueCollection<Car> values(shared);
+            values.emplaceItem("Toyota", "Celica", 1990, 300.0, CarType::DIE_CAST,
+                Condition::GOOD, "1:43", "Красный", false);
+            assert(values.size() == 3 && values.getName() == "Значения");
+            assert(values.totalValue() == 1500.0);
+
+            auto toyotas = values.findByManufacturer("Toyota");
+            assert(toyotas.size() == 2 && toyotas[0] == &values[0]);
+            assert(values.filterByType(CarType::DIE_CAST).size() == 2);
+            assert(values.groupByManufacturer().at("BMW").front()->getModel() == "M3");
+
+            values.sortByPrice(true);
+            assert(values[0].getModel() == "Celica" && values[2].getModel() == "Supra");
+            size_t removed = values.removeIf([](const Car& c) { return c.getCondition() == Condition::POOR; });
+            assert(removed == 1);
+
+            Collection<Car> back = values.toShared();
+            assert(back.size() == 2 && *back[1] == values[1]);
+
+            passedTests++;
+            printTestResult("Коллекция с хранением по значению", true);
+        }
+        
+        // Тест 3.12: Компактные записи
+        {
+            totalTests++;
+            Collection<Car> collection("Компактно");
+            collection.emplaceItem("Lancia", "Stratos", 1974, 1234.56, CarType::RADIO_CONTROLLED,
+                Condition::FAIR, "1:10", "Зеленый", true);
+            collection.emplaceItem("Lancia", "Delta", 1987, 0.1, CarType::CUSTOM_BUILD,
+                Condition::POOR, "1:43", "Зеленый", false);
+
+            CompactCarTable table;
+            table.addAll(collection);
+            assert(sizeof(CompactCar) <= 32);
+            assert(table.size() == 2);
+            assert(table.strings().size() == 6);  // производитель и цвет общие
+            assert(table.toCar(0) == *collection[0]);
+            assert(table.toCar(1) == *collection[1]);
+            assert(table[0].priceKopecks == 123456);
+            assert(table.totalValueKopecks() == 123466);
+            assert(table.findByManufacturer("Lancia").size() == 2);
+            assert(table.findByManufacturer("Fiat").empty());
+            assert(table.filterByCondition(Condition::POOR) == std::vector<size_t>{ 1 });
+
+            // Копия не ссылается на строки исходной таблицы
+            CompactCarTable copied;
+            CompactCarTable assigned;
+            {
+                auto original = std::make_unique<CompactCarTable>();
+                original->addAll(collection);
+                copied = CompactCarTable(*original);
+                assigned = *original;
+            }
+            assert(copied.findByManufacturer("Lancia").size() == 2);
+            assert(copied.strings().find("Зеленый") == table.strings().find("Зеленый"));
+            assert(assigned.toCar(0) == *collection[0]);
+            copied.add(*collection[1]);
+            assert(copied.strings().size() == 6);
+
+            StringPool pool;
+            bool threw = false;
+            try {
+                CompactCar::fromCar(Car("A", "B", 70000, 1.0, CarType::DIE_CAST,
+                    Condition::MINT, "1:64", "C", false), pool);
+            }
+            catch (const std::invalid_argument&) {
+                threw = true;
+            }
+            assert(threw);
+
+            passedTests++;
+            printTestResult("Компактные записи", true);
+        }
+        
+        // Тест 3.13: Денежные суммы с фиксированной точкой
+        {
+            totalTests++;
+            assert(Money::parse("1234.56")->kopecks() == 123456);
+            assert(Money::parse("-0.5")->kopecks() == -50);
+            assert(Money::parse("7")->toString() == "7.00");
+            assert(!Money::parse("1.005") && !Money::parse("12a") && !Money::parse(""));
+            assert(Money::fromDouble(0.1).kopecks() == 10);
+            assert(Money::fromKopecks(-5).toString() == "-0.05");
+
+            // Сумма копеек точна там, где сумма double накапливает ошибку
+            Collection<Car> collection("Деньги");
+            double naive = 0.0;
+            for (int i = 0; i < 1000; ++i) {
+                collection.emplaceItem("Maker", "M", 2000, 0.1, CarType::DIE_CAST,
+                    Condition::GOOD, "1:64", "Черный", false);
+                naive += 0.1;
+            }
+            assert(naive != 100.0);
+            assert(collection.totalMoney() == Money::fromKopecks(10000));
+            assert(collection.totalMoney(4) == collection.totalMoney());
+            assert(collection.totalMoney(3) == collection.totalMoney(7));
+
+            // Одно округление на все множители: 333.33 * 1.3 * 1.5 = 649.9935
+            Car rare("Maker", "R", 2000, *Money::parse("333.33"), CarType::DIE_CAST,
+                Condition::MINT, "1:64", "Черный", true);
+            assert(rare.calculateValue() == Money::fromKopecks(64999));
+            assert(rare.toString().find("Цена: 333.33 руб.") != std::string::npos);
+
+            passedTests++;
+            printTestResult("Денежные суммы с фиксированной точкой", true);
+        }
+        
+        // Тест 3.14: Подписка на изменения
+        {
+            totalTests++;
+            Collection<Car> collection("События");
+            collection.addItem(makeTestCar("before", 1.0));  // без подписчиков событий нет
+
+            // Производная структура: сумма цен, обновляемая по событиям
+            std::unordered_map<uint32_t, Money> prices;
+            Money total = collection.totalMoney();
+            prices[collection.handleAt(0).slot] = collection[0]->getPriceMoney();
+            std::vector<size_t> batchSizes;
+            std::vector<ChangeKind> kinds;
+            size_t id = collection.subscribe([&](const std::vector<Collection<Car>::Change>& batch) {
+                batchSizes.push_back(batch.size());
+                for (const auto& change : batch) {
+                    kinds.push_back(change.kind);
+                    if (change.kind == ChangeKind::INSERT || change.kind == ChangeKind::UPDATE) {
+                        total -= prices[change.handle.slot];
+                        prices[change.handle.slot] = collection.get(change.handle)->getPriceMoney();
+                        total += prices[change.handle.slot];
+                    }
+                    else if (change.kind == ChangeKind::REMOVE) {
+                        total -= prices[change.handle.slot];
+                        prices.erase(change.handle.slot);
+                    }
+                    else if (change.kind == ChangeKind::CLEAR) {
+                        total = Money();
+                        prices.clear();
+                    }
+                }
+            });
+
+            collection.addItem(makeTestCar("a", 10.0));
+            collection.addItems(std::vector<std::shared_ptr<Car>>{ makeTestCar("b", 20.0), makeTestCar("c", 30.0) });
+            assert((batchSizes == std::vector<size_t>{ 1, 2 }));
+            collection.editItem(1, makeTestCar("a2", 15.0));
+            assert(kinds.back() == ChangeKind::UPDATE);
+            {
+                Collection<Car>::ChangeBatch batch(collection);
+                collection.removeItem(0);
+                collection.removeIf([](const Car& c) { return c.getModel() == "c"; });
+                assert(batchSizes.size() == 3);  // пока пакет открыт, доставки нет
+            }
+            assert(batchSizes.back() == 2);
+            assert(total == collection.totalMoney());
+            assert(total == Money::fromKopecks(3500));
+
+            collection.setRemovalMode(RemovalMode::SWAP_AND_POP);
+            collection.addItem(makeTestCar("d", 40.0));
+            collection.removeItem(0);
+            assert(kinds.back() == ChangeKind::MOVE);
+            collection.sortByPrice();
+            assert(kinds.back() == ChangeKind::REORDER);
+
+            // Копия коллекции подписки не наследует
+            Collection<Car> copy(collection);
+            const size_t delivered = batchSizes.size();
+            copy.clear();
+            assert(batchSizes.size() == delivered);
+
+            // Присваивание заменяет содержимое и сообщает об этом одним пакетом
+            Collection<Car> replacement;
+            replacement.addItem(makeTestCar("r1", 60.0));
+            replacement.addItem(makeTestCar("r2", 70.0));
+            kinds.clear();
+            const uint64_t versionBefore = collection.getVersion();
+            collection = replacement;
+            assert(batchSizes.size() == delivered + 1 && batchSizes.back() == 3);
+            assert((kinds == std::vector<ChangeKind>{ ChangeKind::CLEAR, ChangeKind::INSERT, ChangeKind::INSERT }));
+            assert(collection.size() == 2 && collection.getVersion() > versionBefore);
+            assert(replacement.size() == 2);
+            assert(total == collection.totalMoney());
+
+            // Исключение подписчика не выходит из деструктора пакета
+            size_t failing = collection.subscribe([](const std::vector<Collection<Car>::Change>&) {
+                throw std::runtime_error("сбой подписчика");
+            });
+            {
+                Collection<Car>::ChangeBatch batch(collection);
+                collection.addItem(makeTestCar("e", 50.0));
+            }
+            assert(batchSizes.size() == delivered + 2);
+            assert(total == collection.totalMoney());
+
+            bool unsubscribed = collection.unsubscribe(failing) && collection.unsubscribe(id);
+            assert(unsubscribed);
+            collection.clear();
+            assert(batchSizes.size() == delivered + 2);
+
+            passedTests++;
+            printTestResult("Подписка на изменения", true);
+        }
+        
+        // Тест 3.15: Снимки с копированием при записи
+        {
+            totalTests++;
+            Collection<Car> collection("Снимки");
+            const size_t count = 3 * ChunkedVector<int>::CHUNK_SIZE;
+            for (size_t i = 0; i < count; ++i) {
+                collection.emplaceItem("Maker", "M" + std::to_string(i), 2000, 1.0,
+                    CarType::DIE_CAST, Condition::GOOD, "1:64", "Серый", false);
+            }
+
+            auto snapshot = collection.snapshot();
+            assert(snapshot.size() == count && snapshot.getVersion() == collection.getVersion());
+
+            // Запись копирует только затронутый блок
+            const size_t edited = ChunkedVector<int>::CHUNK_SIZE + 5;
+            collection.editItem(edited, std::make_shared<Car>("Other", "X", 2001, 2.0,
+                CarType::DIE_CAST, Condition::GOOD, "1:64", "Серый", false));
+            assert(snapshot[edited]->getModel() == "M" + std::to_string(edited));
+            assert(collection[edited]->getModel() == "X");
+            assert(&collection.begin()[0] == &snapshot[0]);
+            assert(&collection.begin()[edited] != &snapshot[edited]);
+            assert(&collection.begin()[count - 1] == &snapshot[count - 1]);
+
+            // Экспорт снимка в другом потоке, пока коллекция изменяется
+            const std::string snapshotFile = "test_snapshot_export.csv";
+            bool exported = false;
+            std::thread exporter([&]() { exported = FileHandler::exportToCSV(snapshot, snapshotFile); });
+            collection.removeIf([](const Car& c) { return c.getManufacturer() == "Maker"; });
+            collection.emplaceItem("New", "Y", 2002, 3.0, CarType::DIE_CAST, Condition::GOOD,
+                "1:64", "Серый", false);
+            exporter.join();
+            assert(exported);
+            assert(collection.size() == 2);
+
+            Collection<Car> reloaded;
+            bool imported = FileHandler::importFromCSV(reloaded, snapshotFile);
+            assert(imported);
+            assert(reloaded.size() == count);
+            assert(reloaded[edited]->getModel() == "M" + std::to_string(edited));
+            std::remove(snapshotFile.c_str());
+
+            // Исключение из предиката removeIf не теряет строк и ссылок
+            auto kept = collection.handleAt(1);
+            bool threw = false;
+            try {
+                collection.removeIf([](const Car& c) -> bool {
+                    if (c.getManufacturer() == "New") {
+                        throw std::runtime_error("сбой предиката");
+                    }
+                    return true;
+                });
+            }
+            catch (const std::runtime_error&) {
+                threw = true;
+            }
+            assert(threw);
+            assert(collection.size() == 2);
+            assert(collection.get(kept)->getModel() == "Y");
+            assert(collection.rowOf(kept) == size_t(1));
+
+            passedTests++;
+            printTestResult("Снимки с копированием при записи", true);
+        }
+
+        // Тест 3.16: Транзакции
+        {
+            totalTests++;
+            Collection<Car> collection("Транзакции");
+            std::vector<Collection<Car>::Handle> handles;
+            for (int i = 0; i < 5; ++i) {
+                handles.push_back(collection.addItem(makeTestCar("M" + std::to_string(i), 100.0 * (i + 1))));
+            }
+            auto before = collection.snapshot();
+
+            // Сумма цен, поддерживаемая по событиям, должна сойтись с пересчетом
+            std::unordered_map<uint32_t, Money> prices;
+            for (size_t i = 0; i < collection.size(); ++i) {
+                prices[collection.handleAt(i).slot] = collection[i]->getPriceMoney();
+            }
+            Money total = collection.totalMoney();
+            size_t batches = 0;
+            collection.subscribe([&](const std::vector<Collection<Car>::Change>& batch) {
+                batches++;
+                for (const auto& change : batch) {
+                    if (change.kind == ChangeKind::REMOVE || change.kind == ChangeKind::UPDATE) {
+                        total -= prices[change.handle.slot];
+                        prices.erase(change.handle.slot);
+                    }
+                    if (change.kind == ChangeKind::INSERT || change.kind == ChangeKind::UPDATE) {
+                        prices[change.handle.slot] = collection.get(change.handle)->getPriceMoney();
+                        total += prices[change.handle.slot];
+                    }
+                }
+            });
+
+            Collection<Car>::Transaction transaction(collection);
+            transaction.insert(makeTestCar("N1", 7.0));
+            transaction.insert(makeTestCar("N2", 8.0));
+            bool updated = transaction.update(handles[1], makeTestCar("M1*", 1.5));
+            bool updatedAgain = transaction.update(handles[1], makeTestCar("M1**", 2.5));
+            bool removed = transaction.remove(handles[0]);
+            bool removedOther = transaction.remove(handles[3]);
+            bool removedTwice = transaction.remove(handles[0]);
+            bool updatedRemoved = transaction.update(handles[3], makeTestCar("M3*", 9.0));
+            bool updatedInvalid = transaction.update(Collection<Car>::Handle{}, makeTestCar("X", 1.0));
+            assert(updated && updatedAgain && removed && removedOther && removedTwice && updatedRemoved);
+            assert(!updatedInvalid);
+            // До commit коллекция не меняется
+            const uint64_t version = collection.getVersion();
+            assert(collection.size() == 5 && collection[0]->getModel() == "M0");
+
+            bool committed = transaction.commit();
+            assert(committed && transaction.empty());
+            assert(collection.getVersion() == version + 1 && batches == 1);
+            assert(collection.size() == 5);
+            const std::vector<std::string> models = { "M1**", "M2", "M4", "N1", "N2" };
+            for (size_t i = 0; i < models.size(); ++i) {
+                assert(collection[i]->getModel() == models[i]);
+                assert(collection.rowOf(collection.handleAt(i)) == i);
+            }
+            assert(!collection.contains(handles[0]) && !collection.contains(handles[3]));
+            assert(collection.rowOf(handles[4]) == 2u);
+            assert(total == collection.totalMoney());
+            assert(before.size() == 5 && before[1]->getModel() == "M1");
+
+            // Ссылка устарела до commit: не применяется ничего
+            Collection<Car>::Transaction stale(collection);
+            stale.insert(makeTestCar("N3", 1.0));
+            bool staleRemoved = stale.remove(handles[2]);
+            assert(staleRemoved);
+            collection.remove(handles[2]);
+            const uint64_t afterRemove = collection.getVersion();
+            bool staleCommitted = stale.commit();
+            assert(!staleCommitted && !stale.empty());
+            assert(collection.size() == 4 && collection.getVersion() == afterRemove);
+            stale.rollback();
+            assert(stale.empty());
+            bool emptyCommitted = stale.commit();
+            assert(emptyCommitted && collection.getVersion() == afterRemove);
+            assert(total == collection.totalMoney());
+
+            passedTests++;
+            printTestResult("Транзакции: все или ничего, один пакет событий", true);
+        }
+
+        // Тест 3.17: Top-K
+        {
+            totalTests++;
+            Collection<Car> collection;
+            GeneratorConfig config;
+            config.seed = 7;
+            InventoryGenerator generator(config);
+            generator.fill(collection, 3000);
+            const uint64_t version = collection.getVersion();
+            const auto first = collection[0];
+
+            // Эталон: устойчивая сортировка всей коллекции
+            auto byValue = [](const Car& car) { return car.calculateValue(); };
+            std::vector<std::shared_ptr<Car>> sorted(collection.begin(), collection.end());
+            std::stable_sort(sorted.begin(), sorted.end(), [&](const auto& a, const auto& b) {
+                return byValue(*a) > byValue(*b);
+            });
+            auto top = collection.topK(50, byValue);
+            assert(top.size() == 50);
+            assert(std::equal(top.begin(), top.end(), sorted.begin()));
+            assert(collection.topK(50, byValue, 4) == top);
+
+            auto byYear = [](const Car& car) { return car.getYear(); };
+            sorted.assign(collection.begin(), collection.end());
+            std::stable_sort(sorted.begin(), sorted.end(), [&](const auto& a, const auto& b) {
+                return byYear(*a) < byYear(*b);
+            });
+            sorted.resize(20);
+            assert(collection.bottomK(20, byYear) == sorted);
+            assert(collection.bottomK(20, byYear, 3) == sorted);
+
+            auto byPrice = [](const Car& car) { return car.getPriceMoney(); };
+            assert(collection.topK(5000, byPrice).size() == 3000);
+            assert(collection.topK(0, byPrice).empty());
+            assert(collection.getVersion() == version && collection[0] == first);
+
+            passedTests++;
+            printTestResult("Top-K без перестановки коллекции", true);
+        }
+        
         //  ТЕСТ 4: FileHandler 
         printSectionHeader("4. ТЕСТИРОВАНИЕ FILEHANDLER");
         
@@ -465,90 +1133,513 @@ void runUnitTests() {
             printTestResult("CSV файл имеет правильную структуру", true);
         }
         
-        //  ИТОГИ ТЕСТИРОВАНИЯ 
-        printSectionHeader("ИТОГИ ТЕСТИРОВАНИЯ");
-        std::cout << "Пройдено тестов: " << passedTests << " из " << totalTests << "\n";
-        
-        if (passedTests == totalTests) {
-            std::cout << "\n=== ВСЕ ТЕСТЫ УСПЕШНО ПРОЙДЕНЫ ===\n";
-        } else {
-            std::cout << "\n=== НЕКОТОРЫЕ ТЕСТЫ НЕ ПРОЙДЕНЫ ===\n";
-        }
-        
-    } catch (const std::exception& e) {
-        std::cout << "\n!!! ОШИБКА В ТЕСТАХ: " << e.what() << " !!!\n";
-        std::cout << "Пройдено тестов: " << passedTests << " из " << totalTests << "\n";
-    } catch (...) {
-        std::cout << "\n!!! НЕИЗВЕСТНАЯ ОШИБКА В ТЕСТАХ !!!\n";
-        std::cout << "Пройдено тестов: " << passedTests << " из " << totalTests << "\n";
-    }
-}
+        // Тест 4.4: Блочный бинарный формат
+        {
+            totalTests++;
+            Collection<Car> collection("Блочный тест");
 
-//  Функции для пользовательского интерфейса 
-int inputInt(const std::string& prompt) {
-    int value;
-    while (true) {
-        std::cout << prompt;
-        if (std::cin >> value) {
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            return value;
-        }
-        else {
-            std::cout << "Ошибка ввода! Пожалуйста, введите число.\n";
-            std::cin.clear();
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        }
-    }
-}
+            const size_t count = FileHandler::BLOCK_RECORDS * 2 + 5;
+            for (size_t i = 0; i < count; ++i) {
+                collection.addItem(std::make_shared<Car>("Maker" + std::to_string(i % 7),
+                    "Model" + std::to_string(i), 1950 + static_cast<int>(i % 70),
+                    100.0 + static_cast<double>(i), static_cast<CarType>(i % 5),
+                    static_cast<Condition>(i % 5), "1:43", "Green", i % 3 == 0));
+            }
 
-double inputDouble(const std::string& prompt) {
-    double value;
-    while (true) {
-        std::cout << prompt;
-        if (std::cin >> value) {
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            return value;
-        }
-        else {
-            std::cout << "Ошибка ввода! Пожалуйста, введите число.\n";
-            std::cin.clear();
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        }
-    }
-}
+            bool saveSuccess = FileHandler::saveToBinaryParallel(collection, "test_blocks.bin", 4);
+            assert(saveSuccess);
 
-std::string inputString(const std::string& prompt) {
-    std::string value;
-    std::cout << prompt;
-    std::getline(std::cin, value);
-    return value;
-}
+            // loadFromBinary сам распознаёт блочный формат
+            Collection<Car> loadedCollection("Загруженная");
+            bool loadSuccess = FileHandler::loadFromBinary(loadedCollection, "test_blocks.bin", 3);
+            assert(loadSuccess);
+            assert(loadedCollection.size() == count);
 
-CarType selectCarType() {
-    std::cout << "\nВыберите тип машинки:\n";
-    std::cout << "1. Масштабная модель\n";
-    std::cout << "2. Литой металл\n";
-    std::cout << "3. Радиоуправляемая\n";
-    std::cout << "4. Электрическая модель\n";
-    std::cout << "5. Кастомная сборка\n";
+            // Порядок записей сохраняется между блоками
+            for (size_t i = 0; i < count; i += 997) {
+                assert(loadedCollection[i]->getModel() == collection[i]->getModel());
+                assert(loadedCollection[i]->getPrice() == collection[i]->getPrice());
+                assert(loadedCollection[i]->getType() == collection[i]->getType());
+                assert(loadedCollection[i]->isLimitedEdition() == collection[i]->isLimitedEdition());
+            }
+            assert(loadedCollection[count - 1]->getModel() == collection[count - 1]->getModel());
 
-    int choice = inputInt("Ваш выбор (1-5): ");
-    switch (choice) {
-    case 1: return CarType::SCALE_MODEL;
-    case 2: return CarType::DIE_CAST;
-    case 3: return CarType::RADIO_CONTROLLED;
-    case 4: return CarType::ELECTRIC_MODEL;
-    case 5: return CarType::CUSTOM_BUILD;
-    default: return CarType::SCALE_MODEL;
-    }
-}
+            // Заголовок с огромным, но согласованным числом блоков отвергается до выделения памяти
+            {
+                std::fstream patch("test_blocks.bin", std::ios::in | std::ios::out | std::ios::binary);
+                const uint64_t hugeRecords = uint64_t(1) << 40;
+                const uint32_t hugeBlocks = static_cast<uint32_t>(hugeRecords / FileHandler::BLOCK_RECORDS);
+                patch.seekp(sizeof(FileHandler::BLOCK_MAGIC));
+                patch.write(reinterpret_cast<const char*>(&hugeRecords), sizeof(hugeRecords));
+                patch.seekp(sizeof(FileHandler::BLOCK_MAGIC) + sizeof(uint64_t) + sizeof(uint32_t));
+                patch.write(reinterpret_cast<const char*>(&hugeBlocks), sizeof(hugeBlocks));
+            }
+            Collection<Car> corruptedCollection("Поврежденная");
+            bool corruptedLoaded = FileHandler::loadFromBinary(corruptedCollection, "test_blocks.bin", 2);
+            assert(!corruptedLoaded);
+            assert(corruptedCollection.empty());
 
-Condition selectCondition() {
-    std::cout << "\nВыберите состояние:\n";
-    std::cout << "1. Идеальное\n";
-    std::cout << "2. Отличное\n";
-    std::cout << "3. Хорошее\n";
-    std::cout << "4. Удовлетворительное\n";
+            remove("test_blocks.bin");
+
+            passedTests++;
+            printTestResult("Блочный бинарный формат работает корректно", true);
+        }
+
+        // Тест 4.5: Импорт со слиянием
+        {
+            totalTests++;
+            Collection<Car> collection("Слияние");
+
+            collection.addItem(std::make_shared<Car>("Ferrari", "F40", 1987, 15000.0,
+                CarType::SCALE_MODEL, Condition::MINT, "1:18", "Red", true));
+            collection.addItem(std::make_shared<Car>("Porsche", "911", 1973, 12000.0,
+                CarType::DIE_CAST, Condition::EXCELLENT, "1:24", "Silver", false));
+
+            bool exportSuccess = FileHandler::exportToCSV(collection, "test_merge.csv");
+            assert(exportSuccess);
+
+            // Повторный импорт того же файла ничего не дублирует
+            ImportStats stats;
+            bool mergeSuccess = FileHandler::mergeFromCSV(collection, "test_merge.csv", stats);
+            assert(mergeSuccess);
+            assert(collection.size() == 2);
+            assert(stats.inserted == 0 && stats.updated == 0 && stats.skipped == 2);
+
+            // Совпадающий ключ с новой ценой обновляет запись, новый ключ добавляется
+            Collection<Car> incoming;
+            incoming.addItem(std::make_shared<Car>("Porsche", "911", 1973, 13000.0,
+                CarType::DIE_CAST, Condition::EXCELLENT, "1:24", "Silver", false));
+            incoming.addItem(std::make_shared<Car>("Porsche", "911", 1973, 9000.0,
+                CarType::DIE_CAST, Condition::GOOD, "1:43", "Silver", false));
+            stats = FileHandler::mergeInto(collection, incoming);
+            assert(stats.inserted == 1 && stats.updated == 1 && stats.skipped == 0);
+            assert(collection.size() == 3);
+            assert(collection[1]->getPrice() == 13000.0);
+
+            remove("test_merge.csv");
+
+            passedTests++;
+            printTestResult("Импорт со слиянием не создает дубликатов", true);
+        }
+
+        // Тест 4.6: Генератор синтетических данных
+        {
+            totalTests++;
+            GeneratorConfig config;
+            config.seed = 2024;
+            config.manufacturerCount = 50;
+
+            // Одинаковый seed - одинаковые данные
+            InventoryGenerator first(config);
+            InventoryGenerator second(config);
+            for (int i = 0; i < 100; ++i) {
+                Car a = first.next();
+                Car b = second.next();
+                assert(a == b);
+                assert(a.getYear() >= config.minYear && a.getYear() <= config.maxYear);
+                assert(a.getPrice() >= config.minPrice && a.getPrice() <= config.maxPrice);
+            }
+
+            const uint64_t count = FileHandler::BLOCK_RECORDS + 10;
+            bool csvSuccess = InventoryGenerator::writeCSV(config, count, "test_generated.csv");
+            bool binSuccess = InventoryGenerator::writeBinary(config, count, "test_generated.bin");
+            assert(csvSuccess && binSuccess);
+
+            Collection<Car> fromCsv;
+            Collection<Car> fromBin;
+            bool csvLoaded = FileHandler::importFromCSV(fromCsv, "test_generated.csv");
+            bool binLoaded = FileHandler::loadFromBinary(fromBin, "test_generated.bin");
+            assert(csvLoaded && binLoaded);
+            assert(fromCsv.size() == count && fromBin.size() == count);
+            for (size_t i = 0; i < count; i += 409) {
+                assert(*fromCsv[i] == *fromBin[i]);
+            }
+
+            remove("test_generated.csv");
+            remove("test_generated.bin");
+
+            passedTests++;
+            printTestResult("Генератор детерминирован и пишет оба формата", true);
+        }
+
+        // Тест 4.7: Фоновое сохранение
+        {
+            totalTests++;
+            Collection<Car> collection("Фон");
+            InventoryGenerator generator(GeneratorConfig{});
+            generator.fill(collection, 5000);
+            const Car first = *collection[0];
+
+            const std::string file = "test_async.bin";
+            AsyncSave save = AsyncSave::start(collection, file, SaveFormat::BLOCKS);
+            // Изменения после запуска в файл не попадают
+            collection.removeItem(0);
+            collection.clear();
+
+            const SaveReport& report = save.wait();
+            assert(save.ready());
+            assert(report.success && report.error.empty());
+            assert(report.records == 5000 && report.bytes > 0);
+            assert(save.wait().filename == file);
+
+            Collection<Car> loaded;
+            bool loadSuccess = FileHandler::loadFromBinary(loaded, file);
+            assert(loadSuccess);
+            assert(loaded.size() == 5000 && *loaded[0] == first);
+            std::ifstream temp(file + ".tmp");
+            assert(!temp.is_open());
+            remove(file.c_str());
+
+            AsyncSave failed = AsyncSave::start(loaded, "no_such_dir/test_async.csv", SaveFormat::CSV);
+            const SaveReport& failedReport = failed.wait();
+            assert(!failedReport.success && !failedReport.error.empty());
+
+            // Замена не удалась: цель не тронута, новые данные остаются во временном файле
+            const std::string blocked = "test_async_dir";
+            std::filesystem::create_directory(blocked);
+            std::ofstream(blocked + "/keep.txt") << "keep";
+            AsyncSave replaced = AsyncSave::start(loaded, blocked, SaveFormat::CSV);
+            const SaveReport& replacedReport = replaced.wait();
+            assert(!replacedReport.success);
+            assert(replacedReport.error.find(blocked + ".tmp") != std::string::npos);
+            assert(std::filesystem::exists(blocked + "/keep.txt"));
+            assert(std::filesystem::file_size(blocked + ".tmp") > 0);
+            std::filesystem::remove_all(blocked);
+            std::filesystem::remove(blocked + ".tmp");
+
+            passedTests++;
+            printTestResult("Фоновое сохранение из снимка", true);
+        }
+
+        // Тест 4.8: Ход загрузки и отмена
+        {
+            totalTests++;
+            Collection<Car> source;
+            InventoryGenerator generator(GeneratorConfig{});
+            generator.fill(source, 10000);
+            bool csvSaved = FileHandler::exportToCSV(source, "test_progress.csv");
+            bool binSaved = FileHandler::saveToBinary(source, "test_progress.bin");
+            bool blocksSaved = FileHandler::saveToBinaryParallel(source, "test_progress.blk", 2);
+            assert(csvSaved && binSaved && blocksSaved);
+
+            for (const std::string file : { "test_progress.csv", "test_progress.bin", "test_progress.blk" }) {
+                const bool csv = file == "test_progress.csv";
+                auto load = [&](Collection<Car>& target, const LoadOptions& options) {
+                    return csv ? FileHandler::importFromCSV(target, file, options)
+                        : FileHandler::loadFromBinary(target, file, options);
+                };
+
+                // Без отмены: последний отчет - весь файл и все записи
+                Collection<Car> loaded;
+                LoadOptions options;
+                options.batchRows = 1000;
+                options.threadCount = 2;
+                size_t reports = 0;
+                LoadProgress last;
+                options.onProgress = [&](const LoadProgress& progress) {
+                    reports++;
+                    last = progress;
+                };
+                bool loadSuccess = load(loaded, options);
+                assert(loadSuccess);
+                assert(loaded.size() == 10000 && reports > 1);
+                assert(last.rows == 10000 && last.bytesDone == last.bytesTotal && last.bytesTotal > 0);
+
+                // Отмена после первого отчета: коллекция не меняется
+                Collection<Car> target;
+                target.addItem(std::make_shared<Car>("Bburago", "F40", 1987, 1500.0,
+                    CarType::DIE_CAST, Condition::GOOD, "1:24", "Красный", false));
+                const uint64_t version = target.getVersion();
+                CancelToken cancel;
+                options.cancel = &cancel;
+                options.onProgress = [&](const LoadProgress&) { cancel.cancel(); };
+                bool cancelledLoad = load(target, options);
+                assert(!cancelledLoad);
+                assert(target.size() == 1 && target.getVersion() == version);
+                remove(file.c_str());
+            }
+
+            // Строки с CRLF: байты считаются вместе с \r, а \r не попадает в значения.
+            // Строка с ошибкой учитывается в skippedRows
+            {
+                std::ofstream crlf("test_progress_crlf.csv", std::ios::binary);
+                crlf << "Manufacturer;Model;Year;Price;Type;Condition;Scale;Color;LimitedEdition\r\n"
+                    << "Bburago;F40;1987;1500.00;Die Cast;Good;1:24;Red;Yes\r\n"
+                    << "Maisto;Countach;1974;900.50;Scale Model;Mint;1:18;White;Yes\r\n"
+                    << "Broken;Row\r\n";
+            }
+            Collection<Car> crlfLoaded;
+            LoadOptions crlfOptions;
+            LoadProgress crlfLast;
+            crlfOptions.onProgress = [&](const LoadProgress& progress) { crlfLast = progress; };
+            bool crlfSuccess = FileHandler::importFromCSV(crlfLoaded, "test_progress_crlf.csv", crlfOptions);
+            assert(crlfSuccess);
+            assert(crlfLoaded.size() == 2 && crlfLoaded[1]->isLimitedEdition());
+            assert(crlfLast.bytesDone == crlfLast.bytesTotal && crlfLast.rows == 3);
+            assert(crlfLast.skippedRows == 1);
+            remove("test_progress_crlf.csv");
+
+            passedTests++;
+            printTestResult("Ход загрузки и отмена без частичного применения", true);
+        }
+
+        // Тест 4.9: Распределения и квантили
+        {
+            totalTests++;
+            // Пока скетч не сжимался, квантили точные
+            QuantileSketch small;
+            for (int i = 100; i >= 1; --i) {
+                small.add(i);
+            }
+            assert(small.quantile(0.5) == 50.0 && small.rank(50.0) == 0.5);
+            assert(small.quantile(0.0) == 1.0 && small.quantile(1.0) == 100.0);
+
+            // 200000 различных значений: ошибка ранга в пределах 1.5%, в том числе
+            // после объединения четырех скетчей частей
+            const uint64_t n = 200000;
+            QuantileSketch whole;
+            std::vector<QuantileSketch> parts(4);
+            for (uint64_t i = 0; i < n; ++i) {
+                const double value = static_cast<double>((i * 7919) % n);
+                whole.add(value);
+                parts[i % parts.size()].add(value);
+            }
+            for (size_t i = 1; i < parts.size(); ++i) {
+                parts[0].merge(parts[i]);
+            }
+            for (const QuantileSketch* sketch : { &whole, &parts[0] }) {
+                assert(sketch->count() == n && sketch->min() == 0.0 && sketch->max() == n - 1.0);
+                assert(sketch->retained() < 2000);
+                for (double q : { 0.01, 0.1, 0.5, 0.9, 0.99 }) {
+                    assert(std::fabs(sketch->quantile(q) - q * n) <= 0.015 * n);
+                }
+            }
+
+            Histogram bins({ 0.0, 10.0, 100.0 });
+            Histogram more({ 0.0, 10.0, 100.0 });
+            bins.add(5.0);
+            bins.add(-1.0);
+            more.add(50.0);
+            more.add(100.0);
+            bins.merge(more);
+            assert(bins.count(0) == 1 && bins.count(1) == 1 && bins.underflow() == 1 && bins.overflow() == 1);
+            bool mismatch = false;
+            try {
+                bins.merge(Histogram::decimal(1.0, 100.0));
+            }
+            catch (const std::invalid_argument&) {
+                mismatch = true;
+            }
+            assert(mismatch);
+
+            // Сводка по коллекции в одном и в нескольких потоках и по файлам потоково
+            Collection<Car> collection;
+            InventoryGenerator generator(GeneratorConfig{});
+            generator.fill(collection, 20000);
+            InventoryAnalytics serial = InventoryAnalytics::of(collection);
+            InventoryAnalytics parallel = InventoryAnalytics::of(collection, 4);
+            assert(serial.count() == 20000 && parallel.count() == 20000);
+            assert(serial.decadeCounts() == parallel.decadeCounts());
+            assert(serial.priceHistogram().total() == 20000);
+            for (size_t i = 0; i < serial.priceHistogram().binCount(); ++i) {
+                assert(serial.priceHistogram().count(i) == parallel.priceHistogram().count(i));
+            }
+            std::vector<double> values;
+            for (const auto& car : collection) {
+                values.push_back(car->calculateValue().toDouble());
+            }
+            std::sort(values.begin(), values.end());
+            const double median = parallel.valueQuantiles().quantile(0.5);
+            const double medianRank = static_cast<double>(std::upper_bound(values.begin(), values.end(), median)
+                - values.begin()) / values.size();
+            assert(std::fabs(medianRank - 0.5) <= 0.015);
+            assert(parallel.valueByManufacturer().size() == collection.groupByManufacturer().size());
+
+            bool csvSaved = FileHandler::exportToCSV(collection, "test_analytics.csv");
+            bool binSaved = FileHandler::saveToBinaryParallel(collection, "test_analytics.bin");
+            assert(csvSaved && binSaved);
+            InventoryAnalytics files;
+            bool csvAdded = files.addCSV("test_analytics.csv");
+            bool binAdded = files.addBinary("test_analytics.bin");
+            bool missingAdded = files.addBinary("no_such_file.bin");
+            assert(csvAdded && binAdded && !missingAdded && files.count() == 40000);
+            for (const auto& decade : serial.decadeCounts()) {
+                assert(files.decadeCounts().at(decade.first) == 2 * decade.second);
+            }
+            remove("test_analytics.csv");
+            remove("test_analytics.bin");
+
+            passedTests++;
+            printTestResult("Гистограммы и квантили, объединение частей", true);
+        }
+
+        // Тест 5.1: Трассировка
+        printSectionHeader("5. ТЕСТИРОВАНИЕ ИНСТРУМЕНТОВ");
+        {
+            totalTests++;
+            Trace::Tracer& tracer = Trace::Tracer::instance();
+            tracer.reset();
+            {
+                Trace::ScopedTimer timer("test.scope");
+                Trace::Accumulator acc("test.loop");
+                for (int i = 0; i < 3; ++i) {
+                    Trace::Accumulator::Scope step(acc);
+                }
+            }
+            tracer.addCounter("test.counter", 42);
+            assert(!tracer.empty());
+
+            std::ostringstream summary;
+            tracer.printSummary(summary);
+            assert(summary.str().find("test.scope") != std::string::npos);
+            assert(summary.str().find("test.loop") != std::string::npos);
+
+            bool written = tracer.writeChromeTrace("test_trace.json");
+            assert(written);
+            std::ifstream traceFile("test_trace.json");
+            std::string json((std::istreambuf_iterator<char>(traceFile)), std::istreambuf_iterator<char>());
+            traceFile.close();
+            assert(json.find("\"traceEvents\"") != std::string::npos);
+            assert(json.find("\"name\":\"test.scope\",\"ph\":\"X\"") != std::string::npos);
+            assert(json.find("\"value\":42") != std::string::npos);
+
+            remove("test_trace.json");
+            tracer.reset();
+
+            passedTests++;
+            printTestResult("Трассировка пишет Chrome JSON и сводку", true);
+        }
+
+        // Тест 5.2: Учет выделений памяти
+        {
+            totalTests++;
+            AllocProfile::reset();
+            {
+                ALLOC_SCOPE("test.alloc");
+                std::vector<std::string> strings;
+                for (int i = 0; i < 10; ++i) {
+                    strings.push_back(std::string(64, 'x'));
+                }
+            }
+            {
+                AllocProfile::Scope scope("test.explicit");
+            }
+
+            auto stats = AllocProfile::snapshot();
+            assert(stats["test.explicit"].calls == 1);
+            if (AllocProfile::ENABLED) {
+                assert(stats["test.alloc"].calls == 1);
+                assert(stats["test.alloc"].allocations >= 10);
+                assert(stats["test.alloc"].bytes >= 640);
+            }
+            else {
+                assert(AllocProfile::allocationCount() == 0);
+                assert(stats.count("test.alloc") == 0);
+            }
+            AllocProfile::reset();
+
+            passedTests++;
+            printTestResult("Учет выделений памяти по операциям", true);
+        }
+
+        //  ИТОГИ ТЕСТИРОВАНИЯ 
+        printSectionHeader("ИТОГИ ТЕСТИРОВАНИЯ");
+        std::cout << "Пройдено тестов: " << passedTests << " из " << totalTests << "\n";
+        
+        if (passedTests == totalTests) {
+            std::cout << "\n=== ВСЕ ТЕСТЫ УСПЕШНО ПРОЙДЕНЫ ===\n";
+        } else {
+            std::cout << "\n=== НЕКОТОРЫЕ ТЕСТЫ НЕ ПРОЙДЕНЫ ===\n";
+        }
+        
+    } catch (const std::exception& e) {
+        std::cout << "\n!!! ОШИБКА В ТЕСТАХ: " << e.what() << " !!!\n";
+        std::cout << "Пройдено тестов: " << passedTests << " из " << totalTests << "\n";
+    } catch (...) {
+        std::cout << "\n!!! НЕИЗВЕСТНАЯ ОШИБКА В ТЕСТАХ !!!\n";
+        std::cout << "Пройдено тестов: " << passedTests << " из " << totalTests << "\n";
+    }
+}
+
+//  Функции для пользовательского интерфейса 
+
+// Потоки для расчетов по коллекции из меню: параллельная обработка окупается
+// только на больших коллекциях
+constexpr size_t PARALLEL_MIN_ROWS = 100000;
+
+unsigned menuThreadCount(const Collection<Car>& collection) {
+    return collection.size() >= PARALLEL_MIN_ROWS ? std::thread::hardware_concurrency() : 1;
+}
+
+int inputInt(const std::string& prompt) {
+    int value;
+    while (true) {
+        std::cout << prompt;
+        if (std::cin >> value) {
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            return value;
+        }
+        else {
+            std::cout << "Ошибка ввода! Пожалуйста, введите число.\n";
+            std::cin.clear();
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+    }
+}
+
+// Без пробелов и \r (ввод из файла с CRLF) по краям
+std::string trimmed(const std::string& value) {
+    const auto isSpace = [](unsigned char c) { return std::isspace(c) != 0; };
+    auto first = std::find_if_not(value.begin(), value.end(), isSpace);
+    auto last = std::find_if_not(value.rbegin(), value.rend(), isSpace).base();
+    return first < last ? std::string(first, last) : std::string();
+}
+
+// Цена читается строкой и разбирается точно, без округления через double
+Money inputMoney(const std::string& prompt) {
+    while (true) {
+        std::cout << prompt;
+        std::string value;
+        std::getline(std::cin, value);
+        if (auto parsed = Money::parse(trimmed(value))) {
+            return *parsed;
+        }
+        std::cout << "Ошибка ввода! Пожалуйста, введите сумму (например, 1234.56).\n";
+    }
+}
+
+std::string inputString(const std::string& prompt) {
+    std::string value;
+    std::cout << prompt;
+    std::getline(std::cin, value);
+    return value;
+}
+
+CarType selectCarType() {
+    std::cout << "\nВыберите тип машинки:\n";
+    std::cout << "1. Масштабная модель\n";
+    std::cout << "2. Литой металл\n";
+    std::cout << "3. Радиоуправляемая\n";
+    std::cout << "4. Электрическая модель\n";
+    std::cout << "5. Кастомная сборка\n";
+
+    int choice = inputInt("Ваш выбор (1-5): ");
+    switch (choice) {
+    case 1: return CarType::SCALE_MODEL;
+    case 2: return CarType::DIE_CAST;
+    case 3: return CarType::RADIO_CONTROLLED;
+    case 4: return CarType::ELECTRIC_MODEL;
+    case 5: return CarType::CUSTOM_BUILD;
+    default: return CarType::SCALE_MODEL;
+    }
+}
+
+Condition selectCondition() {
+    std::cout << "\nВыберите состояние:\n";
+    std::cout << "1. Идеальное\n";
+    std::cout << "2. Отличное\n";
+    std::cout << "3. Хорошее\n";
+    std::cout << "4. Удовлетворительное\n";
     std::cout << "5. Плохое\n";
 
     int choice = inputInt("Ваш выбор (1-5): ");
@@ -562,13 +1653,141 @@ Condition selectCondition() {
     }
 }
 
+// Режим импорта: true - слияние без дубликатов, false - добавление всех записей
+bool selectMergeMode() {
+    std::cout << "\nРежим импорта:\n";
+    std::cout << "1 - добавить все записи\n";
+    std::cout << "2 - объединить без дубликатов (обновить совпадающие)\n";
+    return inputInt("Ваш выбор: ") == 2;
+}
+
+void printImportStats(const ImportStats& stats) {
+    std::cout << "  Добавлено: " << stats.inserted
+        << ", обновлено: " << stats.updated
+        << ", пропущено: " << stats.skipped << "\n";
+}
+
+// Ctrl+C во время загрузки отменяет ее, а не завершает программу
+CancelToken interruptedLoad;
+
+extern "C" void cancelLoadOnInterrupt(int) {
+    interruptedLoad.cancel();
+}
+
+// Загрузка из меню: ход выводится в одной строке, коллекция меняется только при успехе
+bool loadWithProgress(const std::function<bool(const LoadOptions&)>& load) {
+    interruptedLoad.reset();
+    auto previous = std::signal(SIGINT, cancelLoadOnInterrupt);
+    std::cout << "(Ctrl+C - отменить загрузку)\n";
+
+    LoadOptions options;
+    options.cancel = &interruptedLoad;
+    options.onProgress = [](const LoadProgress& progress) {
+        const double mb = 1024.0 * 1024.0;
+        std::cout << "\r  " << std::fixed << std::setprecision(1) << progress.bytesDone / mb
+            << " из " << progress.bytesTotal / mb << " МБ, " << progress.rows << " записей, "
+            << std::setprecision(0) << progress.rowsPerSecond() << " записей/с, осталось ~"
+            << progress.etaSeconds() << " с   " << std::flush;
+    };
+
+    bool success = load(options);
+    std::signal(SIGINT, previous);
+    std::cout << "\n";
+    // Ctrl+C после последней проверки (или во время слияния) отмены не вызывает:
+    // загрузка завершилась и коллекция изменена
+    if (!success && interruptedLoad.cancelled()) {
+        std::cout << "Загрузка отменена, коллекция не изменена.\n";
+    }
+    return success;
+}
+
+// Постраничный просмотр: выводится только текущая страница
+void browsePages(const Collection<Car>& collection, const CollectionView<Car>& view,
+    size_t pageSize = 10) {
+    PageCursor cursor(view.size(), pageSize);
+    while (true) {
+        std::string buffer = "\n=== Коллекция: " + collection.getName() + " ===\n";
+        buffer += "Показано машинок: " + std::to_string(view.size()) + " из "
+            + std::to_string(collection.size()) + "\n";
+        buffer += "Страница " + std::to_string(cursor.page() + 1) + " из "
+            + std::to_string(cursor.pageCount()) + "\n";
+        buffer += "========================================\n";
+        if (view.empty()) {
+            buffer += "Нет машинок для показа.\n";
+        }
+        view.renderPage(buffer, cursor.offset(), cursor.limit());
+        std::cout << buffer;
+
+        if (cursor.pageCount() <= 1) {
+            return;
+        }
+        std::string command = inputString("[n] далее, [p] назад, номер страницы, Enter - выход: ");
+        if (command == "n" || command == "т") {
+            cursor.next();
+        }
+        else if (command == "p" || command == "з") {
+            cursor.prev();
+        }
+        else if (!command.empty() && std::all_of(command.begin(), command.end(),
+            [](unsigned char c) { return std::isdigit(c); })) {
+            // Слишком длинный номер не помещается в size_t - такой страницы тоже нет
+            bool moved = false;
+            try {
+                moved = cursor.goTo(static_cast<size_t>(std::stoull(command)) - 1);
+            }
+            catch (const std::out_of_range&) {
+            }
+            if (!moved) {
+                std::cout << "Нет такой страницы.\n";
+            }
+        }
+        else {
+            return;
+        }
+    }
+}
+
+void browseCollection(const Collection<Car>& collection) {
+    std::cout << "\nПросмотр коллекции:\n";
+    std::cout << "1 - в текущем порядке\n";
+    std::cout << "2 - по цене (сначала дорогие)\n";
+    std::cout << "3 - по году выпуска\n";
+    std::cout << "4 - только выбранного типа\n";
+    std::cout << "5 - только в выбранном состоянии\n";
+    int mode = inputInt("Ваш выбор: ");
+
+    // Сортировка и фильтр применяются к представлению, порядок коллекции не меняется
+    CollectionView<Car> view(collection);
+    switch (mode) {
+    case 2:
+        view.sortBy([](const Car& a, const Car& b) { return a.getPriceMoney() > b.getPriceMoney(); });
+        break;
+    case 3:
+        view.sortBy([](const Car& a, const Car& b) { return a.getYear() < b.getYear(); });
+        break;
+    case 4: {
+        CarType type = selectCarType();
+        view.filter([type](const Car& car) { return car.getType() == type; });
+        break;
+    }
+    case 5: {
+        Condition condition = selectCondition();
+        view.filter([condition](const Car& car) { return car.getCondition() == condition; });
+        break;
+    }
+    default:
+        break;
+    }
+    browsePages(collection, view);
+}
+
 void addCar(Collection<Car>& collection) {
     std::cout << "\n=== Добавление новой машинки ===\n";
 
     std::string manufacturer = inputString("Производитель: ");
     std::string model = inputString("Модель: ");
     int year = inputInt("Год выпуска: ");
-    double price = inputDouble("Цена (руб.): ");
+    Money price = inputMoney("Цена (руб.): ");
     CarType type = selectCarType();
     Condition condition = selectCondition();
     std::string scale = inputString("Масштаб (например, 1:64): ");
@@ -589,7 +1808,18 @@ void removeCar(Collection<Car>& collection) {
         return;
     }
 
-    collection.displayAll();
+    std::cout << "\n1 - удалить одну машинку\n";
+    std::cout << "2 - удалить все машинки в выбранном состоянии\n";
+    if (inputInt("Ваш выбор: ") == 2) {
+        Condition condition = selectCondition();
+        size_t removed = collection.removeIf([condition](const Car& car) {
+            return car.getCondition() == condition;
+        });
+        std::cout << "Удалено машинок: " << removed << "\n";
+        return;
+    }
+
+    browsePages(collection, CollectionView<Car>(collection));
     int index = inputInt("Введите номер машинки для удаления: ") - 1;
 
     try {
@@ -608,7 +1838,7 @@ void editCar(Collection<Car>& collection) {
         return;
     }
 
-    collection.displayAll();
+    browsePages(collection, CollectionView<Car>(collection));
     int index = inputInt("Введите номер машинки для редактирования: ") - 1;
 
     try {
@@ -649,13 +1879,13 @@ void editCar(Collection<Car>& collection) {
         }
 
         // Цена
-        std::string priceStr = inputString("Цена [" + std::to_string(currentCar->getPrice()) + "] (введите число или нажмите Enter): ");
-        double price = currentCar->getPrice();
+        std::string priceStr = trimmed(inputString("Цена [" + currentCar->getPriceMoney().toString() + "] (введите число или нажмите Enter): "));
+        Money price = currentCar->getPriceMoney();
         if (!priceStr.empty()) {
-            try {
-                price = std::stod(priceStr);
+            if (auto parsed = Money::parse(priceStr)) {
+                price = *parsed;
             }
-            catch (...) {
+            else {
                 std::cout << "Неверный формат цены, сохранено старое значение.\n";
             }
         }
@@ -723,6 +1953,58 @@ void editCar(Collection<Car>& collection) {
     }
 }
 
+void searchCars(const Collection<Car>& collection, TextIndex& textIndex) {
+    if (collection.empty()) {
+        std::cout << "Коллекция пуста!\n";
+        return;
+    }
+
+    std::cout << "\nРежим поиска:\n";
+    std::cout << "1 - точное совпадение производителя\n";
+    std::cout << "2 - начало названия производителя или модели\n";
+    std::cout << "3 - часть названия производителя или модели\n";
+    std::cout << "4 - нечеткий поиск (с опечатками)\n";
+    int mode = inputInt("Ваш выбор: ");
+    std::string query = inputString("Введите запрос: ");
+
+    if (mode == 1) {
+        auto results = collection.findByManufacturer(query);
+        std::cout << "Найдено " << results.size() << " машинок:\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            results[i]->displayInfo();
+            std::cout << "\n";
+        }
+        return;
+    }
+
+    // Индекс перестраивается только после изменений коллекции
+    if (textIndex.isStale(collection)) {
+        textIndex.build(collection);
+    }
+    if (mode == 4) {
+        auto matches = textIndex.findFuzzy(query, 2);
+        std::cout << "Похожие названия: " << matches.size() << "\n";
+        for (const auto& match : matches) {
+            std::cout << "  " << match.term << " (отличий: " << match.distance
+                << ", машинок: " << match.rows.size() << ")\n";
+        }
+        for (const auto& match : matches) {
+            for (size_t row : match.rows) {
+                collection[row]->displayInfo();
+                std::cout << "\n";
+            }
+        }
+        return;
+    }
+
+    auto rows = mode == 2 ? textIndex.findPrefix(query) : textIndex.findSubstring(query);
+    std::cout << "Найдено " << rows.size() << " машинок:\n";
+    for (size_t row : rows) {
+        collection[row]->displayInfo();
+        std::cout << "\n";
+    }
+}
+
 void displayMenu() {
     std::cout << "\n════════════════════════════════════════\n";
     std::cout << "     КАТАЛОГ КОЛЛЕКЦИОННЫХ МАШИНОК      \n";
@@ -731,7 +2013,7 @@ void displayMenu() {
     std::cout << "2.  Добавить машинку\n";
     std::cout << "3.  Удалить машинку\n";
     std::cout << "4.  Редактировать машинку\n";
-    std::cout << "5.  Поиск по производителю\n";
+    std::cout << "5.  Поиск по производителю/модели\n";
     std::cout << "6.  Фильтр по типу\n";
     std::cout << "7.  Фильтр по состоянию\n";
     std::cout << "8.  Сортировать по году\n";
@@ -744,22 +2026,597 @@ void displayMenu() {
     std::cout << "15. Загрузить из бинарного файла\n";
     std::cout << "16. Показать статистику\n";
     std::cout << "17. Запустить unit-тесты\n";
+    std::cout << "18. Самые ценные / дешевые машинки\n";
     std::cout << "0.  Выход\n";
     std::cout << "════════════════════════════════════════\n";
     std::cout << "Выберите действие: ";
 }
 
-int main() {
+// Первые N машинок по цене, году или оценке (с учетом состояния и редкости);
+// коллекция при этом не сортируется
+void showTopCars(const Collection<Car>& collection) {
+    std::cout << "\nКритерий:\n";
+    std::cout << "1 - цена\n";
+    std::cout << "2 - год выпуска\n";
+    std::cout << "3 - оценка стоимости (состояние, редкость)\n";
+    int criterion = inputInt("Ваш выбор: ");
+    std::cout << "1 - наибольшие\n";
+    std::cout << "2 - наименьшие\n";
+    bool largest = inputInt("Ваш выбор: ") != 2;
+    int count = inputInt("Сколько показать: ");
+    if (count <= 0) {
+        std::cout << "Количество должно быть положительным!\n";
+        return;
+    }
+
+    const unsigned threads = menuThreadCount(collection);
+    const size_t k = static_cast<size_t>(count);
+    auto select = [&](auto key) {
+        return largest ? collection.topK(k, key, threads) : collection.bottomK(k, key, threads);
+    };
+    std::vector<std::shared_ptr<Car>> cars;
+    switch (criterion) {
+    case 2:
+        cars = select([](const Car& car) { return car.getYear(); });
+        break;
+    case 3:
+        cars = select([](const Car& car) { return car.calculateValue(); });
+        break;
+    default:
+        cars = select([](const Car& car) { return car.getPriceMoney(); });
+        break;
+    }
+
+    for (size_t i = 0; i < cars.size(); ++i) {
+        std::cout << (i + 1) << ". ";
+        cars[i]->displayInfo();
+        std::cout << "   Оценка стоимости: " << cars[i]->calculateValue() << " руб.\n";
+    }
+}
+
+//  Пакетный режим командной строки 
+//
+//  car_collection <команда> [аргументы]
+//  Коды возврата: 0 - успех, 1 - неверные аргументы, 2 - ошибка чтения/записи,
+//  3 - команда выполнена, но часть строк CSV пропущена из-за ошибок разбора
+namespace Cli {
+    constexpr int EXIT_OK = 0;
+    constexpr int EXIT_USAGE = 1;
+    constexpr int EXIT_IO = 2;
+    constexpr int EXIT_PARTIAL = 3;
+
+    void printUsage(std::ostream& out) {
+        out << "Использование: car_collection [команда] [аргументы]\n"
+            << "Без команды запускается интерактивное меню.\n"
+            << "--trace <файл> перед командой записывает трассу (сборка с -DCARS_TRACE).\n"
+            << "Код возврата 3: команда выполнена, но часть строк CSV пропущена из-за ошибок.\n\n"
+            << "Команды (формат файла определяется расширением: .csv - CSV, иначе бинарный):\n"
+            << "  import <источник> <цель> [--merge]   добавить (или объединить) записи в файл цели\n"
+            << "  export <источник> <файл.csv>         выгрузить коллекцию в CSV\n"
+            << "  convert <вход> <выход>               преобразовать между CSV и бинарным форматом\n"
+            << "  query <файл> [фильтры]               вывести подходящие машинки в CSV на stdout\n"
+            << "      --manufacturer <имя>   точное совпадение производителя\n"
+            << "      --search <текст>       часть названия производителя или модели\n"
+            << "      --prefix <текст>       начало названия производителя или модели\n"
+            << "      --type <тип>           Scale Model, Die Cast, Radio Controlled, ...\n"
+            << "      --condition <сост.>    Mint, Excellent, Good, Fair, Poor\n"
+            << "      --limit <N>            не более N записей\n"
+            << "  generate <N> <файл> [параметры]      записать N синтетических машинок потоком\n"
+            << "      --seed <N>  --manufacturers <N>  --skew <X>  --models <N>\n"
+            << "      --years <от-до>  --prices <от-до>  --limited-rate <доля>\n"
+            << "      --conditions <mint,excellent,good,fair,poor>   веса состояний\n"
+            << "  stats <файл>                         количество, стоимость, разбивка по производителям\n"
+            << "  analyze <файл> [файл...]             распределения цен, годов и оценок (потоковое чтение)\n"
+            << "  bench <файл>                         время загрузки, сортировки, группировки и сохранения\n"
+            << "  help                                 эта справка\n";
+    }
+
+    bool isCsv(const std::string& filename) {
+        const std::string ext = ".csv";
+        if (filename.size() < ext.size()) {
+            return false;
+        }
+        std::string tail = filename.substr(filename.size() - ext.size());
+        std::transform(tail.begin(), tail.end(), tail.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return tail == ext;
+    }
+
+    // Отчет о ходе загрузки CSV: число строк, пропущенных из-за ошибок разбора
+    LoadOptions countSkipped(size_t& skipped) {
+        LoadOptions options;
+        options.onProgress = [&skipped](const LoadProgress& progress) { skipped = progress.skippedRows; };
+        return options;
+    }
+
+    // skipped увеличивается на число строк CSV, пропущенных из-за ошибок разбора
+    bool load(Collection<Car>& collection, const std::string& filename, size_t& skipped) {
+        if (!isCsv(filename)) {
+            return FileHandler::loadFromBinary(collection, filename);
+        }
+        size_t fileSkipped = 0;
+        const bool loaded = FileHandler::importFromCSV(collection, filename, countSkipped(fileSkipped));
+        skipped += fileSkipped;
+        return loaded;
+    }
+
+    // Потерянные строки не должны оставаться незамеченными для скриптов
+    int finish(size_t skipped) {
+        if (skipped > 0) {
+            std::cerr << "Пропущено строк с ошибками: " << skipped << "\n";
+            return EXIT_PARTIAL;
+        }
+        return EXIT_OK;
+    }
+
+    // std::stoull принимает "-1" и возвращает 2^64-1, поэтому знак и лишние символы
+    // проверяются отдельно
+    uint64_t parseCount(const std::string& value) {
+        if (value.empty() || !std::isdigit(static_cast<unsigned char>(value[0]))) {
+            throw std::invalid_argument("ожидается неотрицательное целое: " + value);
+        }
+        size_t used = 0;
+        const uint64_t count = std::stoull(value, &used);
+        if (used != value.size()) {
+            throw std::invalid_argument("ожидается неотрицательное целое: " + value);
+        }
+        return count;
+    }
+
+    bool save(const Collection<Car>& collection, const std::string& filename) {
+        return isCsv(filename) ? FileHandler::exportToCSV(collection, filename)
+            : FileHandler::saveToBinaryParallel(collection, filename);
+    }
+
+    bool fileExists(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        return file.is_open();
+    }
+
+    int runImport(const std::vector<std::string>& args) {
+        if (args.size() < 2) {
+            printUsage(std::cerr);
+            return EXIT_USAGE;
+        }
+        const bool merge = std::find(args.begin() + 2, args.end(), "--merge") != args.end();
+
+        size_t skipped = 0;
+        Collection<Car> target;
+        if (fileExists(args[1]) && !load(target, args[1], skipped)) {
+            return EXIT_IO;
+        }
+
+        Collection<Car> incoming;
+        if (!load(incoming, args[0], skipped)) {
+            return EXIT_IO;
+        }
+
+        ImportStats stats;
+        if (merge) {
+            stats = FileHandler::mergeInto(target, incoming);
+        }
+        else {
+            target.addItems(incoming.begin(), incoming.end());
+            stats.inserted = incoming.size();
+        }
+
+        if (!save(target, args[1])) {
+            return EXIT_IO;
+        }
+        std::cout << "inserted=" << stats.inserted << " updated=" << stats.updated
+            << " skipped=" << stats.skipped << " total=" << target.size() << "\n";
+        return finish(skipped);
+    }
+
+    int runConvert(const std::vector<std::string>& args) {
+        if (args.size() != 2) {
+            printUsage(std::cerr);
+            return EXIT_USAGE;
+        }
+        size_t skipped = 0;
+        Collection<Car> collection;
+        if (!load(collection, args[0], skipped) || !save(collection, args[1])) {
+            return EXIT_IO;
+        }
+        std::cout << "converted=" << collection.size() << "\n";
+        return finish(skipped);
+    }
+
+    int runExport(const std::vector<std::string>& args) {
+        if (args.size() != 2 || !isCsv(args[1])) {
+            printUsage(std::cerr);
+            return EXIT_USAGE;
+        }
+        return runConvert(args);
+    }
+
+    int runQuery(const std::vector<std::string>& args) {
+        if (args.empty()) {
+            printUsage(std::cerr);
+            return EXIT_USAGE;
+        }
+
+        std::string manufacturer, search, prefix;
+        std::optional<CarType> type;
+        std::optional<Condition> condition;
+        size_t limit = std::numeric_limits<size_t>::max();
+
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (i + 1 >= args.size()) {
+                std::cerr << "Не указано значение для " << args[i] << "\n";
+                return EXIT_USAGE;
+            }
+            const std::string& option = args[i];
+            const std::string& value = args[++i];
+            if (option == "--manufacturer") {
+                manufacturer = value;
+            }
+            else if (option == "--search") {
+                search = value;
+            }
+            else if (option == "--prefix") {
+                prefix = value;
+            }
+            else if (option == "--type") {
+                type = EnumUtils::parseCarType(value);
+                if (!type) {
+                    std::cerr << "Неизвестный тип: " << value << "\n";
+                    return EXIT_USAGE;
+                }
+            }
+            else if (option == "--condition") {
+                condition = EnumUtils::parseCondition(value);
+                if (!condition) {
+                    std::cerr << "Неизвестное состояние: " << value << "\n";
+                    return EXIT_USAGE;
+                }
+            }
+            else if (option == "--limit") {
+                try {
+                    limit = static_cast<size_t>(parseCount(value));
+                }
+                catch (const std::exception&) {
+                    std::cerr << "Неверное значение --limit: " << value << "\n";
+                    return EXIT_USAGE;
+                }
+            }
+            else {
+                std::cerr << "Неизвестный параметр: " << option << "\n";
+                return EXIT_USAGE;
+            }
+        }
+
+        size_t skipped = 0;
+        Collection<Car> collection;
+        if (!load(collection, args[0], skipped)) {
+            return EXIT_IO;
+        }
+
+        // Текстовые условия сужают набор строк через индекс, остальные проверяются по строкам
+        std::vector<size_t> rows;
+        const bool textFilter = !search.empty() || !prefix.empty();
+        if (textFilter) {
+            TextIndex index;
+            index.build(collection);
+            rows = !prefix.empty() ? index.findPrefix(prefix) : index.findSubstring(search);
+            if (!prefix.empty() && !search.empty()) {
+                std::vector<size_t> bySearch = index.findSubstring(search);
+                std::vector<size_t> both;
+                std::set_intersection(rows.begin(), rows.end(), bySearch.begin(), bySearch.end(),
+                    std::back_inserter(both));
+                rows.swap(both);
+            }
+        }
+
+        FileHandler::writeCSVHeader(std::cout);
+        size_t written = 0;
+        auto emit = [&](const Car& car) {
+            if ((!manufacturer.empty() && car.getManufacturer() != manufacturer) ||
+                (type && car.getType() != *type) ||
+                (condition && car.getCondition() != *condition)) {
+                return;
+            }
+            FileHandler::writeCSVRow(std::cout, car);
+            ++written;
+        };
+
+        if (textFilter) {
+            for (size_t i = 0; i < rows.size() && written < limit; ++i) {
+                emit(*collection[rows[i]]);
+            }
+        }
+        else {
+            for (auto it = collection.begin(); it != collection.end() && written < limit; ++it) {
+                emit(**it);
+            }
+        }
+        std::cout.flush();
+        return std::cout ? finish(skipped) : EXIT_IO;
+    }
+
+    // Разбирает "a-b" или "a,b,c" в список чисел
+    std::vector<double> parseNumbers(const std::string& value, char separator) {
+        std::vector<double> numbers;
+        std::stringstream ss(value);
+        std::string token;
+        while (std::getline(ss, token, separator)) {
+            numbers.push_back(std::stod(token));
+        }
+        return numbers;
+    }
+
+    int runGenerate(const std::vector<std::string>& args) {
+        if (args.size() < 2 || args.size() % 2 != 0) {
+            printUsage(std::cerr);
+            return EXIT_USAGE;
+        }
+
+        GeneratorConfig config;
+        uint64_t count = 0;
+        try {
+            count = parseCount(args[0]);
+            for (size_t i = 2; i + 1 < args.size(); i += 2) {
+                const std::string& option = args[i];
+                const std::string& value = args[i + 1];
+                if (option == "--seed") {
+                    config.seed = parseCount(value);
+                }
+                else if (option == "--manufacturers") {
+                    config.manufacturerCount = static_cast<size_t>(parseCount(value));
+                }
+                else if (option == "--skew") {
+                    config.manufacturerSkew = std::stod(value);
+                }
+                else if (option == "--models") {
+                    config.modelsPerManufacturer = static_cast<size_t>(parseCount(value));
+                }
+                else if (option == "--years") {
+                    auto range = parseNumbers(value, '-');
+                    if (range.size() != 2) throw std::invalid_argument(option);
+                    config.minYear = static_cast<int>(range[0]);
+                    config.maxYear = static_cast<int>(range[1]);
+                }
+                else if (option == "--prices") {
+                    auto range = parseNumbers(value, '-');
+                    if (range.size() != 2) throw std::invalid_argument(option);
+                    config.minPrice = range[0];
+                    config.maxPrice = range[1];
+                }
+                else if (option == "--limited-rate") {
+                    config.limitedEditionRate = std::stod(value);
+                }
+                else if (option == "--conditions") {
+                    auto weights = parseNumbers(value, ',');
+                    if (weights.size() != 5) throw std::invalid_argument(option);
+                    std::copy(weights.begin(), weights.end(), config.conditionWeights);
+                }
+                else {
+                    std::cerr << "Неизвестный параметр: " << option << "\n";
+                    return EXIT_USAGE;
+                }
+            }
+            // Проверка параметров до создания файла
+            InventoryGenerator check(config);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Неверные параметры генерации: " << e.what() << "\n";
+            return EXIT_USAGE;
+        }
+
+        const bool ok = isCsv(args[1]) ? InventoryGenerator::writeCSV(config, count, args[1])
+            : InventoryGenerator::writeBinary(config, count, args[1]);
+        if (!ok) {
+            return EXIT_IO;
+        }
+        std::cout << "generated=" << count << "\n";
+        return EXIT_OK;
+    }
+
+    int runStats(const std::vector<std::string>& args) {
+        if (args.size() != 1) {
+            printUsage(std::cerr);
+            return EXIT_USAGE;
+        }
+        size_t skipped = 0;
+        Collection<Car> collection;
+        if (!load(collection, args[0], skipped)) {
+            return EXIT_IO;
+        }
+
+        std::cout << "count=" << collection.size() << "\n"
+            << "total_value=" << collection.totalMoney() << "\n";
+        for (const auto& group : collection.groupByManufacturer()) {
+            Money sum;
+            for (const auto& car : group.second) {
+                sum += car->getPriceMoney();
+            }
+            std::cout << "manufacturer=" << group.first << ";count=" << group.second.size()
+                << ";total_value=" << sum << "\n";
+        }
+        return finish(skipped);
+    }
+
+    // Каждый файл читается потоково в своем потоке, сводки объединяются
+    int runAnalyze(const std::vector<std::string>& args) {
+        if (args.empty()) {
+            printUsage(std::cerr);
+            return EXIT_USAGE;
+        }
+
+        std::vector<std::future<std::optional<InventoryAnalytics>>> parts;
+        std::vector<size_t> skippedPerFile(args.size(), 0);
+        for (size_t i = 0; i < args.size(); ++i) {
+            parts.push_back(std::async(std::launch::async,
+                [&filename = args[i], &skipped = skippedPerFile[i]]() -> std::optional<InventoryAnalytics> {
+                    InventoryAnalytics part;
+                    bool ok = isCsv(filename) ? part.addCSV(filename, countSkipped(skipped))
+                        : part.addBinary(filename);
+                    return ok ? std::optional<InventoryAnalytics>(std::move(part)) : std::nullopt;
+                }));
+        }
+
+        InventoryAnalytics analytics;
+        bool failed = false;
+        for (auto& part : parts) {
+            auto result = part.get();
+            if (result) {
+                analytics.merge(*result);
+            }
+            else {
+                failed = true;
+            }
+        }
+        if (failed) {
+            return EXIT_IO;
+        }
+        analytics.print(std::cout);
+        return finish(std::accumulate(skippedPerFile.begin(), skippedPerFile.end(), size_t(0)));
+    }
+
+    int runBench(const std::vector<std::string>& args) {
+        if (args.size() != 1) {
+            printUsage(std::cerr);
+            return EXIT_USAGE;
+        }
+
+        using Clock = std::chrono::steady_clock;
+        auto measure = [](const char* name, size_t items, const std::function<void()>& step) {
+            auto start = Clock::now();
+            step();
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            std::cout << std::fixed << std::setprecision(3) << name << "_ms=" << ms
+                << ";ns_per_item=" << (items ? ms * 1e6 / items : 0.0) << "\n";
+        };
+
+        Collection<Car> collection;
+        bool loaded = false;
+        size_t skipped = 0;
+        measure("load", 0, [&]() { loaded = load(collection, args[0], skipped); });
+        if (!loaded) {
+            return EXIT_IO;
+        }
+        const size_t n = collection.size();
+        std::cout << "count=" << n << "\n";
+
+        measure("sort_by_price", n, [&]() { collection.sortByPrice(true); });
+        measure("sort_by_manufacturer", n, [&]() { collection.sortByManufacturer(true); });
+        measure("group_by_manufacturer", n, [&]() { collection.groupByManufacturer(); });
+        measure("total_value", n, [&]() { collection.totalValue(); });
+
+        const std::string tmp = args[0] + ".bench.tmp";
+        bool saved = false;
+        measure("save_binary", n, [&]() { saved = FileHandler::saveToBinaryParallel(collection, tmp); });
+        std::remove(tmp.c_str());
+        return saved ? finish(skipped) : EXIT_IO;
+    }
+
+    int dispatch(const std::string& command, const std::vector<std::string>& args);
+
+    int run(int argc, char* argv[]) {
+        std::vector<std::string> words(argv + 1, argv + argc);
+
+        // --trace <файл> перед командой: трасса Chrome JSON и сводка в stderr
+        std::string traceFile;
+        if (words.size() >= 2 && words[0] == "--trace") {
+            traceFile = words[1];
+            words.erase(words.begin(), words.begin() + 2);
+            if (!Trace::ENABLED) {
+                std::cerr << "Трассировка не включена при сборке (нужен флаг -DCARS_TRACE)\n";
+            }
+        }
+        if (words.empty()) {
+            printUsage(std::cerr);
+            return EXIT_USAGE;
+        }
+
+        const std::vector<std::string> args(words.begin() + 1, words.end());
+        int code = dispatch(words[0], args);
+
+        if (!traceFile.empty() && Trace::ENABLED) {
+            Trace::Tracer::instance().printSummary(std::cerr);
+            if (!Trace::Tracer::instance().writeChromeTrace(traceFile) && code == EXIT_OK) {
+                code = EXIT_IO;
+            }
+        }
+        return code;
+    }
+
+    int dispatch(const std::string& command, const std::vector<std::string>& args) {
+        if (command == "help" || command == "--help" || command == "-h") {
+            printUsage(std::cout);
+            return EXIT_OK;
+        }
+        if (command == "import") return runImport(args);
+        if (command == "export") return runExport(args);
+        if (command == "convert") return runConvert(args);
+        if (command == "query") return runQuery(args);
+        if (command == "generate") return runGenerate(args);
+        if (command == "stats") return runStats(args);
+        if (command == "bench") return runBench(args);
+        if (command == "analyze") return runAnalyze(args);
+
+        std::cerr << "Неизвестная команда: " << command << "\n";
+        printUsage(std::cerr);
+        return EXIT_USAGE;
+    }
+}
+
+// Запускает фоновое сохранение, если в этот файл уже не идет запись
+void startSave(std::vector<AsyncSave>& saves, const Collection<Car>& collection,
+    const std::string& filename, SaveFormat format) {
+    for (const auto& save : saves) {
+        if (save.getFilename() == filename) {
+            std::cout << "Сохранение в " << filename << " уже идет, дождитесь его завершения.\n";
+            return;
+        }
+    }
+    saves.push_back(AsyncSave::start(collection, filename, format));
+    std::cout << "Сохранение в " << filename << " запущено в фоне, можно продолжать работу.\n";
+}
+
+// Печатает итоги завершенных сохранений; waitAll - дождаться всех (при выходе)
+void reportSaves(std::vector<AsyncSave>& saves, bool waitAll) {
+    for (auto it = saves.begin(); it != saves.end();) {
+        if (!waitAll && !it->ready()) {
+            ++it;
+            continue;
+        }
+        const SaveReport& report = it->wait();
+        if (report.success) {
+            std::cout << "\n[Фон] Сохранено в " << report.filename << ": " << report.records
+                << " машинок, " << report.bytes << " байт за " << std::fixed << std::setprecision(2)
+                << report.seconds << " с (" << std::setprecision(0) << report.recordsPerSecond()
+                << " машинок/с, " << std::setprecision(1) << report.megabytesPerSecond() << " МБ/с)\n";
+        }
+        else {
+            std::cout << "\n[Фон] Ошибка сохранения в " << report.filename << ": " << report.error << "\n";
+        }
+        it = saves.erase(it);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        return Cli::run(argc, argv);
+    }
+
     Collection<Car> collection("Моя коллекция машинок");
+    TextIndex textIndex;
+    std::vector<AsyncSave> saves;
 
     int choice;
     do {
+        reportSaves(saves, false);
         displayMenu();
         choice = inputInt("");
 
         switch (choice) {
         case 1:
-            collection.displayAll();
+            if (collection.empty()) {
+                collection.displayAll();
+                break;
+            }
+            browseCollection(collection);
             break;
 
         case 2:
@@ -774,20 +2631,9 @@ int main() {
             editCar(collection);
             break;
 
-        case 5: {
-            if (collection.empty()) {
-                std::cout << "Коллекция пуста!\n";
-                break;
-            }
-            std::string manufacturer = inputString("Введите производителя: ");
-            auto results = collection.findByManufacturer(manufacturer);
-            std::cout << "Найдено " << results.size() << " машинок:\n";
-            for (size_t i = 0; i < results.size(); ++i) {
-                results[i]->displayInfo();
-                std::cout << "\n";
-            }
+        case 5:
+            searchCars(collection, textIndex);
             break;
-        }
 
         case 6: {
             if (collection.empty()) {
@@ -879,13 +2725,8 @@ int main() {
                 std::cout << "Коллекция пуста, нечего экспортировать!\n";
                 break;
             }
-            if (FileHandler::exportToCSV(collection, "collection.csv")) {
-                std::cout << "Экспорт успешно завершен в файл collection.csv!\n";
-                std::cout << "  (CSV файл содержит данные на английском языке)\n";
-            }
-            else {
-                std::cout << "Ошибка экспорта!\n";
-            }
+            startSave(saves, collection, "collection.csv", SaveFormat::CSV);
+            std::cout << "  (CSV файл содержит данные на английском языке)\n";
             break;
 
         case 13: {
@@ -893,9 +2734,18 @@ int main() {
             if (filename.empty()) {
                 filename = "collection.csv";
             }
-            if (FileHandler::importFromCSV(collection, filename)) {
+            bool merge = selectMergeMode();
+            ImportStats stats;
+            bool success = loadWithProgress([&](const LoadOptions& options) {
+                return merge ? FileHandler::mergeFromCSV(collection, filename, stats, options)
+                    : FileHandler::importFromCSV(collection, filename, options);
+            });
+            if (success) {
                 std::cout << "Импорт успешно завершен из файла " << filename << "!\n";
                 std::cout << "  (CSV файл должен содержать данные на английском языке)\n";
+                if (merge) {
+                    printImportStats(stats);
+                }
             }
             else {
                 std::cout << "Ошибка импорта!\n";
@@ -908,12 +2758,7 @@ int main() {
                 std::cout << "Коллекция пуста, нечего сохранять!\n";
                 break;
             }
-            if (FileHandler::saveToBinary(collection, "collection.bin")) {
-                std::cout << "Сохранение успешно завершено в файл collection.bin!\n";
-            }
-            else {
-                std::cout << "Ошибка сохранения!\n";
-            }
+            startSave(saves, collection, "collection.bin", SaveFormat::BLOCKS);
             break;
 
         case 15: {
@@ -921,8 +2766,17 @@ int main() {
             if (filename.empty()) {
                 filename = "collection.bin";
             }
-            if (FileHandler::loadFromBinary(collection, filename)) {
+            bool merge = selectMergeMode();
+            ImportStats stats;
+            bool success = loadWithProgress([&](const LoadOptions& options) {
+                return merge ? FileHandler::mergeFromBinary(collection, filename, stats, options)
+                    : FileHandler::loadFromBinary(collection, filename, options);
+            });
+            if (success) {
                 std::cout << "Загрузка успешно завершена из файла " << filename << "!\n";
+                if (merge) {
+                    printImportStats(stats);
+                }
             }
             else {
                 std::cout << "Ошибка загрузки!\n";
@@ -933,20 +2787,49 @@ int main() {
         case 16:
             std::cout << "\n=== Статистика коллекции ===\n";
             std::cout << "Количество машинок: " << collection.size() << "\n";
-            std::cout << "Общая стоимость: " << std::fixed << std::setprecision(2) << collection.totalValue() << " руб.\n";
+            std::cout << "Общая стоимость: " << collection.totalMoney() << " руб.\n";
+            if (!collection.empty()) {
+                std::cout << "\n=== Распределения ===\n";
+                InventoryAnalytics::of(collection, menuThreadCount(collection)).print(std::cout);
+                std::cout << "\n";
+            }
+            for (const auto& save : saves) {
+                std::cout << "Идет сохранение в " << save.getFilename() << ": "
+                    << std::fixed << std::setprecision(1) << save.elapsedSeconds() << " с\n";
+            }
+            if (Trace::ENABLED && !Trace::Tracer::instance().empty()) {
+                std::cout << "\n=== Время операций ===\n";
+                Trace::Tracer::instance().printSummary(std::cout);
+            }
+            if (AllocProfile::ENABLED) {
+                std::cout << "\n=== Выделения памяти по операциям ===\n";
+                AllocProfile::printReport(std::cout);
+            }
             break;
 
         case 17:
             runUnitTests();
             break;
 
+        case 18:
+            if (collection.empty()) {
+                std::cout << "Коллекция пуста!\n";
+                break;
+            }
+            showTopCars(collection);
+            break;
+
         case 0:
+            if (!saves.empty()) {
+                std::cout << "Ожидание завершения фоновых сохранений...\n";
+                reportSaves(saves, true);
+            }
             std::cout << "\nСпасибо за использование программы!\n";
             std::cout << "До свидания!\n";
             break;
 
         default:
-            std::cout << "Неверный выбор! Пожалуйста, выберите действие от 0 до 17.\n";
+            std::cout << "Неверный выбор! Пожалуйста, выберите действие от 0 до 18.\n";
             break;
         }
     } while (choice != 0);